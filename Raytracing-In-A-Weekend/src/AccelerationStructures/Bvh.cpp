@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "AccelerationStructures/Bvh.h"
+#include "Core/SceneArena.h"
 
 inline bool boxCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b, int axis)
 {
@@ -13,4 +15,56 @@ inline bool boxCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<
 
 bool boxXCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) { return boxCompare(a, b, 0); }
 bool boxYCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) { return boxCompare(a, b, 1); }
-bool boxZCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) { return boxCompare(a, b, 2); }
\ No newline at end of file
+bool boxZCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b) { return boxCompare(a, b, 2); }
+
+BVHNode::BVHNode(SceneArena& arena, std::vector<std::shared_ptr<Hittable>>& objects, size_t start, size_t end)
+{
+    size_t objectSpan = end - start;
+    if (objectSpan == 1)
+    {
+        left = right = objects[start];
+    }
+    else if (objectSpan == 2)
+    {
+        left = objects[start];
+        right = objects[start + 1];
+    }
+    else
+    {
+        glm::vec3 centroidMin(infinity, infinity, infinity);
+        glm::vec3 centroidMax(-infinity, -infinity, -infinity);
+        for (size_t i = start; i < end; i++)
+        {
+            AABB objectBox;
+            objects[i]->BoundingBox(objectBox);
+            glm::vec3 centroid = (objectBox.minimum + objectBox.maximum) * 0.5f;
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = 0;
+        if (extent.y > extent.x)
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+
+        size_t mid = start + objectSpan / 2;
+        std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end,
+            [axis](const std::shared_ptr<Hittable>& a, const std::shared_ptr<Hittable>& b)
+            {
+                AABB boxA;
+                AABB boxB;
+                a->BoundingBox(boxA);
+                b->BoundingBox(boxB);
+                return boxA.minimum[axis] + boxA.maximum[axis] < boxB.minimum[axis] + boxB.maximum[axis];
+            });
+        left = arena.Make<BVHNode>(arena, objects, start, mid);
+        right = arena.Make<BVHNode>(arena, objects, mid, end);
+    }
+
+    AABB boxLeft;
+    AABB boxRight;
+    if (!left->BoundingBox(boxLeft) || !right->BoundingBox(boxRight))
+        std::cerr << "No bounding box in BVHNode Constructor." << std::endl;
+    box = surroundingBox(boxLeft, boxRight);
+}
@@ -3,6 +3,9 @@
 #include "Core/RTWeekend.h"
 
 #include "Core/Hittable.h"
+#include "Core/MemoryTracker.h"
+
+class SceneArena;
 
 inline bool boxCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b, int axis);
 
@@ -13,8 +16,13 @@ bool boxZCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittab
 class BVHNode : public Hittable
 {
 public:
+    static constexpr MemoryCategory ArenaCategory = MemoryCategory::BvhNodes;
+
     BVHNode() = default;
     BVHNode(const HittableList& list) : BVHNode(list.objects, 0, list.objects.size(), -1) {}
+    // Builds the tree over objects[start, end) in place, reordering them, with its nodes created in the arena.
+    // Splits are at the median centroid of the widest axis, so the same scene always gives the same tree.
+    BVHNode(SceneArena& arena, std::vector<std::shared_ptr<Hittable>>& objects, size_t start, size_t end);
     BVHNode(const std::vector<std::shared_ptr<Hittable>>& srcObjects, size_t start, size_t end, int maxDepth)
     {
         auto objects = srcObjects;
@@ -93,6 +101,13 @@ public:
         return true;
     }
 
+    virtual void CollectEmitters(std::vector<LightTriangle>& emitters) override
+    {
+        left->CollectEmitters(emitters);
+        if (right != left)
+            right->CollectEmitters(emitters);
+    }
+
 public:
     std::shared_ptr<Hittable> left;
     std::shared_ptr<Hittable> right;
@@ -0,0 +1,421 @@
+#include <algorithm>
+#include "AccelerationStructures/LightBvh.h"
+#include "Core/Hittable.h"
+#include "Material/Material.h"
+
+static float safeSqrt(float x)
+{
+    return sqrt(fmax(0.0f, x));
+}
+
+// cos(max(0, thetaA - thetaB))
+static float cosSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+    if (cosThetaA > cosThetaB)
+        return 1.0f;
+    return cosThetaA * cosThetaB + sinThetaA * sinThetaB;
+}
+
+// sin(max(0, thetaA - thetaB))
+static float sinSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+    if (cosThetaA > cosThetaB)
+        return 0.0f;
+    return sinThetaA * cosThetaB - cosThetaA * sinThetaB;
+}
+
+// Rodrigues rotation of v around the unit axis k
+static glm::vec3 rotateAround(const glm::vec3& v, const glm::vec3& k, float theta)
+{
+    float cosTheta = cos(theta);
+    float sinTheta = sin(theta);
+    return v * cosTheta + glm::cross(k, v) * sinTheta + k * glm::dot(k, v) * (1.0f - cosTheta);
+}
+
+float LightBounds::Importance(const glm::vec3& p, const glm::vec3& n) const
+{
+    glm::vec3 pc = (bounds.minimum + bounds.maximum) * 0.5f;
+    glm::vec3 diagonal = bounds.maximum - bounds.minimum;
+    float d2 = glm::dot(p - pc, p - pc);
+    d2 = fmax(d2, glm::length(diagonal) * 0.5f);
+
+    glm::vec3 wi = p - pc;
+    float wiLength = glm::length(wi);
+    wi = wiLength > 0.0f ? wi / wiLength : w;
+    float cosThetaW = glm::dot(w, wi);
+    if (twoSided)
+        cosThetaW = fabs(cosThetaW);
+    float sinThetaW = safeSqrt(1.0f - cosThetaW * cosThetaW);
+
+    //Angle subtended by the bounding sphere of the box as seen from p
+    float radius2 = glm::dot(diagonal, diagonal) * 0.25f;
+    float cosThetaB = -1.0f;
+    if (glm::dot(p - pc, p - pc) >= radius2)
+        cosThetaB = safeSqrt(1.0f - radius2 / glm::dot(p - pc, p - pc));
+    float sinThetaB = safeSqrt(1.0f - cosThetaB * cosThetaB);
+
+    //Minimum angle between the emission cone and the direction towards p
+    float sinThetaO = safeSqrt(1.0f - cosThetaO * cosThetaO);
+    float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= cosThetaE)
+        return 0.0f;
+
+    float importance = phi * cosThetaP / d2;
+
+    //Bound the cosine at the receiving surface as well
+    if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+    {
+        float cosThetaI = fabs(glm::dot(wi, n));
+        float sinThetaI = safeSqrt(1.0f - cosThetaI * cosThetaI);
+        importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return fmax(importance, 0.0f);
+}
+
+LightBounds unionBounds(const LightBounds& a, const LightBounds& b)
+{
+    if (a.phi == 0.0f)
+        return b;
+    if (b.phi == 0.0f)
+        return a;
+
+    LightBounds result;
+    result.bounds = surroundingBox(a.bounds, b.bounds);
+    result.phi = a.phi + b.phi;
+    result.cosThetaE = fmin(a.cosThetaE, b.cosThetaE);
+    result.twoSided = a.twoSided || b.twoSided;
+
+    //Union of the two direction cones
+    float thetaA = acos(clamp(a.cosThetaO, -1.0f, 1.0f));
+    float thetaB = acos(clamp(b.cosThetaO, -1.0f, 1.0f));
+    float thetaD = acos(clamp(glm::dot(a.w, b.w), -1.0f, 1.0f));
+    if (fmin(thetaD + thetaB, pi) <= thetaA)
+    {
+        result.w = a.w;
+        result.cosThetaO = a.cosThetaO;
+        return result;
+    }
+    if (fmin(thetaD + thetaA, pi) <= thetaB)
+    {
+        result.w = b.w;
+        result.cosThetaO = b.cosThetaO;
+        return result;
+    }
+
+    float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+    glm::vec3 wr = glm::cross(a.w, b.w);
+    if (thetaO >= pi || glm::dot(wr, wr) == 0.0f)
+    {
+        result.w = a.w;
+        result.cosThetaO = -1.0f;
+        return result;
+    }
+
+    result.w = rotateAround(a.w, glm::normalize(wr), thetaO - thetaA);
+    result.cosThetaO = cos(thetaO);
+    return result;
+}
+
+// Surface area orientation heuristic, PBRT-v4 LightBVHAggregate::EvaluateCost
+static float evaluateCost(const LightBounds& b, const AABB& bounds, int dim)
+{
+    float thetaO = acos(clamp(b.cosThetaO, -1.0f, 1.0f));
+    float thetaE = acos(clamp(b.cosThetaE, -1.0f, 1.0f));
+    float thetaW = fmin(thetaO + thetaE, pi);
+    float sinThetaO = safeSqrt(1.0f - b.cosThetaO * b.cosThetaO);
+    float mOmega = 2.0f * pi * (1.0f - b.cosThetaO) +
+        pi / 2.0f * (2.0f * thetaW * sinThetaO - cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + b.cosThetaO);
+
+    glm::vec3 d = bounds.maximum - bounds.minimum;
+    float kr = fmax(d.x, fmax(d.y, d.z)) / d[dim];
+
+    glm::vec3 bd = b.bounds.maximum - b.bounds.minimum;
+    float surfaceArea = 2.0f * (bd.x * bd.y + bd.x * bd.z + bd.y * bd.z);
+
+    return b.phi * mOmega * kr * surfaceArea;
+}
+
+LightBVH::LightBVH(Hittable& world)
+{
+    world.CollectEmitters(lights);
+    bitTrails.resize(lights.size(), 0);
+
+    std::vector<std::pair<int, LightBounds>> bvhLights;
+    for (int i = 0; i < (int)lights.size(); i++)
+    {
+        const LightTriangle& light = lights[i];
+        if (light.power <= 0.0f)
+            continue;
+
+        LightBounds lightBounds;
+        lightBounds.bounds = AABB(glm::min(light.p0, glm::min(light.p1, light.p2)), glm::max(light.p0, glm::max(light.p1, light.p2)));
+        lightBounds.w = light.normal;
+        lightBounds.phi = light.power;
+        lightBounds.cosThetaO = 1.0f;
+        lightBounds.cosThetaE = 0.0f; //Diffuse emitters fall off over a full hemisphere
+        lightBounds.twoSided = light.twoSided;
+        bvhLights.push_back({ i, lightBounds });
+    }
+
+    if (bvhLights.empty())
+        return;
+
+    nodes.reserve(2 * bvhLights.size());
+    leafLights.reserve(bvhLights.size());
+    buildRecursive(bvhLights, 0, bvhLights.size(), 0, 0);
+}
+
+int LightBVH::buildRecursive(std::vector<std::pair<int, LightBounds>>& bvhLights, size_t start, size_t end, uint64_t bitTrail, int depth)
+{
+    if (end - start == 1 || depth == MaxDepth)
+    {
+        //Only many coincident emitters get this deep, the leaf picks between them by power
+        int nodeIndex = (int)nodes.size();
+        nodes.push_back({ LightBounds(), (int)leafLights.size(), (int)(end - start) });
+        for (size_t i = start; i < end; i++)
+        {
+            nodes[nodeIndex].lightBounds = unionBounds(nodes[nodeIndex].lightBounds, bvhLights[i].second);
+            leafLights.push_back(bvhLights[i].first);
+            bitTrails[bvhLights[i].first] = bitTrail;
+        }
+        return nodeIndex;
+    }
+
+    AABB bounds = bvhLights[start].second.bounds;
+    glm::vec3 centroidMin(infinity, infinity, infinity);
+    glm::vec3 centroidMax(-infinity, -infinity, -infinity);
+    for (size_t i = start; i < end; i++)
+    {
+        const AABB& b = bvhLights[i].second.bounds;
+        bounds = surroundingBox(bounds, b);
+        glm::vec3 pc = (b.minimum + b.maximum) * 0.5f;
+        centroidMin = glm::min(centroidMin, pc);
+        centroidMax = glm::max(centroidMax, pc);
+    }
+
+    const int bucketCount = 12;
+    float minCost = infinity;
+    int minCostSplitBucket = -1;
+    int minCostSplitDim = -1;
+
+    for (int dim = 0; dim < 3; dim++)
+    {
+        if (centroidMax[dim] == centroidMin[dim])
+            continue;
+
+        auto bucketOf = [&](const LightBounds& lb)
+        {
+            float pc = (lb.bounds.minimum[dim] + lb.bounds.maximum[dim]) * 0.5f;
+            int b = (int)(bucketCount * (pc - centroidMin[dim]) / (centroidMax[dim] - centroidMin[dim]));
+            return b >= bucketCount ? bucketCount - 1 : b;
+        };
+
+        LightBounds bucketBounds[bucketCount];
+        for (size_t i = start; i < end; i++)
+        {
+            int b = bucketOf(bvhLights[i].second);
+            bucketBounds[b] = unionBounds(bucketBounds[b], bvhLights[i].second);
+        }
+
+        for (int i = 0; i < bucketCount - 1; i++)
+        {
+            LightBounds b0, b1;
+            for (int j = 0; j <= i; j++)
+                b0 = unionBounds(b0, bucketBounds[j]);
+            for (int j = i + 1; j < bucketCount; j++)
+                b1 = unionBounds(b1, bucketBounds[j]);
+
+            float cost = evaluateCost(b0, bounds, dim) + evaluateCost(b1, bounds, dim);
+            if (cost > 0.0f && cost < minCost)
+            {
+                minCost = cost;
+                minCostSplitBucket = i;
+                minCostSplitDim = dim;
+            }
+        }
+    }
+
+    size_t mid;
+    if (minCostSplitDim == -1)
+    {
+        mid = (start + end) / 2;
+    }
+    else
+    {
+        int dim = minCostSplitDim;
+        auto midIter = std::partition(bvhLights.begin() + start, bvhLights.begin() + end, [&](const std::pair<int, LightBounds>& l)
+            {
+                float pc = (l.second.bounds.minimum[dim] + l.second.bounds.maximum[dim]) * 0.5f;
+                int b = (int)(bucketCount * (pc - centroidMin[dim]) / (centroidMax[dim] - centroidMin[dim]));
+                return (b >= bucketCount ? bucketCount - 1 : b) <= minCostSplitBucket;
+            });
+        mid = midIter - bvhLights.begin();
+        if (mid == start || mid == end)
+            mid = (start + end) / 2;
+    }
+
+    int nodeIndex = (int)nodes.size();
+    nodes.push_back({ LightBounds(), -1, 0 });
+    int child0 = buildRecursive(bvhLights, start, mid, bitTrail, depth + 1);
+    int child1 = buildRecursive(bvhLights, mid, end, bitTrail | (uint64_t(1) << depth), depth + 1);
+
+    nodes[nodeIndex].lightBounds = unionBounds(nodes[child0].lightBounds, nodes[child1].lightBounds);
+    nodes[nodeIndex].childOrLightIndex = child1;
+    return nodeIndex;
+}
+
+bool LightBVH::Sample(const glm::vec3& p, const glm::vec3& n, LightSample& sample) const
+{
+    if (nodes.empty())
+        return false;
+
+    int nodeIndex = 0;
+    float pmf = 1.0f;
+    while (nodes[nodeIndex].lightCount == 0)
+    {
+        const Node& node = nodes[nodeIndex];
+        float ci0 = nodes[nodeIndex + 1].lightBounds.Importance(p, n);
+        float ci1 = nodes[node.childOrLightIndex].lightBounds.Importance(p, n);
+        if (ci0 == 0.0f && ci1 == 0.0f)
+            return false;
+
+        float p0 = ci0 / (ci0 + ci1);
+        if (randomFloat() < p0)
+        {
+            nodeIndex = nodeIndex + 1;
+            pmf *= p0;
+        }
+        else
+        {
+            nodeIndex = node.childOrLightIndex;
+            pmf *= 1.0f - p0;
+        }
+    }
+
+    const Node& leaf = nodes[nodeIndex];
+    if (nodeIndex == 0 && leaf.lightBounds.Importance(p, n) == 0.0f)
+        return false;
+
+    int lightIndex = leafLights[leaf.childOrLightIndex];
+    if (leaf.lightCount > 1)
+    {
+        float power = leafPower(leaf);
+        float target = randomFloat() * power;
+        for (int i = 0; i < leaf.lightCount; i++)
+        {
+            lightIndex = leafLights[leaf.childOrLightIndex + i];
+            target -= lights[lightIndex].power;
+            if (target < 0.0f)
+                break;
+        }
+        pmf *= lights[lightIndex].power / power;
+    }
+
+    //Uniformly sample a point on the chosen triangle
+    const LightTriangle& light = lights[lightIndex];
+    float su0 = sqrt(randomFloat());
+    float b0 = 1.0f - su0;
+    float b1 = randomFloat() * su0;
+    float b2 = 1.0f - b0 - b1;
+    glm::vec3 point = b0 * light.p0 + b1 * light.p1 + b2 * light.p2;
+    glm::vec2 uv = b0 * light.uv0 + b1 * light.uv1 + b2 * light.uv2;
+
+    glm::vec3 toLight = point - p;
+    float dist2 = glm::dot(toLight, toLight);
+    if (dist2 == 0.0f)
+        return false;
+    glm::vec3 wi = toLight / sqrt(dist2);
+
+    float cosLight = -glm::dot(light.normal, wi);
+    if (!light.twoSided && cosLight <= 0.0f)
+        return false;
+    cosLight = fabs(cosLight);
+    if (cosLight == 0.0f)
+        return false;
+
+    HitRecord rec;
+    rec.p = point;
+    rec.u = uv.x;
+    rec.v = uv.y;
+    rec.setFaceNormal(Ray(p, toLight), light.normal);
+    rec.matPtr = light.matPtr;
+
+    sample.p = point;
+    sample.normal = light.normal;
+    sample.radiance = light.matPtr->emitted(Ray(p, toLight), rec, rec.u, rec.v, point);
+    sample.pdf = pmf * dist2 / (cosLight * light.area);
+    return true;
+}
+
+float LightBVH::Pdf(const glm::vec3& p, const glm::vec3& n, int lightIndex, const glm::vec3& lightPoint) const
+{
+    if (lightIndex < 0 || lightIndex >= (int)lights.size())
+        return 0.0f;
+
+    const LightTriangle& light = lights[lightIndex];
+    glm::vec3 toLight = lightPoint - p;
+    float dist2 = glm::dot(toLight, toLight);
+    if (dist2 == 0.0f)
+        return 0.0f;
+
+    float cosLight = -glm::dot(light.normal, toLight / sqrt(dist2));
+    if (!light.twoSided && cosLight <= 0.0f)
+        return 0.0f;
+    cosLight = fabs(cosLight);
+    if (cosLight == 0.0f)
+        return 0.0f;
+
+    return pmf(p, n, lightIndex) * dist2 / (cosLight * light.area);
+}
+
+float LightBVH::pmf(const glm::vec3& p, const glm::vec3& n, int lightIndex) const
+{
+    if (nodes.empty() || lights[lightIndex].power <= 0.0f)
+        return 0.0f;
+
+    uint64_t bitTrail = bitTrails[lightIndex];
+    int nodeIndex = 0;
+    float pmf = 1.0f;
+    while (nodes[nodeIndex].lightCount == 0)
+    {
+        const Node& node = nodes[nodeIndex];
+        float ci0 = nodes[nodeIndex + 1].lightBounds.Importance(p, n);
+        float ci1 = nodes[node.childOrLightIndex].lightBounds.Importance(p, n);
+        if (ci0 == 0.0f && ci1 == 0.0f)
+            return 0.0f;
+
+        if (bitTrail & 1)
+        {
+            pmf *= ci1 / (ci0 + ci1);
+            nodeIndex = node.childOrLightIndex;
+        }
+        else
+        {
+            pmf *= ci0 / (ci0 + ci1);
+            nodeIndex = nodeIndex + 1;
+        }
+        bitTrail >>= 1;
+    }
+
+    if (nodeIndex == 0 && nodes[0].lightBounds.Importance(p, n) == 0.0f)
+        return 0.0f;
+
+    const Node& leaf = nodes[nodeIndex];
+    for (int i = 0; i < leaf.lightCount; i++)
+    {
+        if (leafLights[leaf.childOrLightIndex + i] == lightIndex)
+            return leaf.lightCount == 1 ? pmf : pmf * lights[lightIndex].power / leafPower(leaf);
+    }
+    return 0.0f;
+}
+
+float LightBVH::leafPower(const Node& leaf) const
+{
+    float power = 0.0f;
+    for (int i = 0; i < leaf.lightCount; i++)
+        power += lights[leafLights[leaf.childOrLightIndex + i]].power;
+    return power;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Core/RTWeekend.h"
+#include "AccelerationStructures/AABB.h"
+
+class Material;
+class Hittable;
+
+// An emissive triangle as seen by the light sampler
+struct LightTriangle
+{
+    glm::vec3 p0, p1, p2;
+    glm::vec2 uv0, uv1, uv2;
+    glm::vec3 normal; //Outward facing geometric normal
+    float area;
+    float power;
+    bool twoSided;
+    std::shared_ptr<Material> matPtr;
+};
+
+// Cone of emission directions (axis w, spread thetaO) plus the falloff thetaE around it, see PBRT-v4 "Light BVH"
+struct LightBounds
+{
+    AABB bounds;
+    glm::vec3 w;
+    float phi = 0.0f;
+    float cosThetaO = 1.0f;
+    float cosThetaE = 1.0f;
+    bool twoSided = false;
+
+    float Importance(const glm::vec3& p, const glm::vec3& n) const;
+};
+
+LightBounds unionBounds(const LightBounds& a, const LightBounds& b);
+
+struct LightSample
+{
+    glm::vec3 p;
+    glm::vec3 normal;
+    glm::vec3 radiance;
+    float pdf; //Solid angle pdf as seen from the shading point, includes the light selection probability
+};
+
+class LightBVH
+{
+public:
+    LightBVH(Hittable& world);
+
+    bool Empty() const { return nodes.empty(); }
+    const std::vector<LightTriangle>& Lights() const { return lights; }
+
+    // Stochastically walks the hierarchy and picks a light with probability proportional to its estimated contribution at p
+    bool Sample(const glm::vec3& p, const glm::vec3& n, LightSample& sample) const;
+
+    // Solid angle pdf of Sample() choosing lightIndex and hitting it at lightPoint
+    float Pdf(const glm::vec3& p, const glm::vec3& n, int lightIndex, const glm::vec3& lightPoint) const;
+
+private:
+    //Deepest level a bit trail can describe, lights still together there share one leaf
+    static constexpr int MaxDepth = 64;
+
+    struct Node
+    {
+        LightBounds lightBounds;
+        int childOrLightIndex; //Second child for interior nodes, the first child always follows its parent. First entry in leafLights for leaves.
+        int lightCount; //0 for interior nodes
+    };
+
+    std::vector<LightTriangle> lights;
+    std::vector<Node> nodes;
+    std::vector<int> leafLights; //Lights of each leaf, almost always just one
+    std::vector<uint64_t> bitTrails; //Path from the root to each light, one bit per level (1 = second child)
+
+    int buildRecursive(std::vector<std::pair<int, LightBounds>>& bvhLights, size_t start, size_t end, uint64_t bitTrail, int depth);
+    float pmf(const glm::vec3& p, const glm::vec3& n, int lightIndex) const;
+    float leafPower(const Node& leaf) const;
+};
\ No newline at end of file
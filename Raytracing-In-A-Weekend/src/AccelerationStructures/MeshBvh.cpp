@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <numeric>
+#include "AccelerationStructures/MeshBvh.h"
+
+namespace
+{
+    struct BuildState
+    {
+        const std::vector<glm::vec3>& minimums;
+        const std::vector<glm::vec3>& maximums;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t>& order;
+        std::vector<MeshBVHNode> nodes;
+    };
+
+    // Splits at the centroid median of the widest axis, deterministic so the same input always gives the same tree
+    void buildNode(BuildState& state, uint32_t start, uint32_t end)
+    {
+        uint32_t nodeIndex = (uint32_t)state.nodes.size();
+        state.nodes.emplace_back();
+
+        glm::vec3 minimum(infinity, infinity, infinity);
+        glm::vec3 maximum(-infinity, -infinity, -infinity);
+        glm::vec3 centroidMin(infinity, infinity, infinity);
+        glm::vec3 centroidMax(-infinity, -infinity, -infinity);
+        for (uint32_t i = start; i < end; i++)
+        {
+            uint32_t triangle = state.order[i];
+            minimum = glm::min(minimum, state.minimums[triangle]);
+            maximum = glm::max(maximum, state.maximums[triangle]);
+            centroidMin = glm::min(centroidMin, state.centroids[triangle]);
+            centroidMax = glm::max(centroidMax, state.centroids[triangle]);
+        }
+        state.nodes[nodeIndex].minimum = minimum;
+        state.nodes[nodeIndex].maximum = maximum;
+
+        if (end - start <= (uint32_t)MeshBVH::LeafSize)
+        {
+            state.nodes[nodeIndex].offset = start;
+            state.nodes[nodeIndex].count = (uint16_t)(end - start);
+            state.nodes[nodeIndex].axis = 0;
+            return;
+        }
+
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = 0;
+        if (extent.y > extent.x)
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+
+        //The lower half is rounded up to whole leaves, so all leaves but one per subtree are full and there are fewer nodes
+        uint32_t half = (end - start) / 2;
+        uint32_t middle = start + (half + MeshBVH::LeafSize - 1) / MeshBVH::LeafSize * MeshBVH::LeafSize;
+        const std::vector<glm::vec3>& centroids = state.centroids;
+        std::nth_element(state.order.begin() + start, state.order.begin() + middle, state.order.begin() + end,
+            [&centroids, axis](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis] || (centroids[a][axis] == centroids[b][axis] && a < b); });
+
+        buildNode(state, start, middle);
+        state.nodes[nodeIndex].offset = (uint32_t)state.nodes.size();
+        state.nodes[nodeIndex].count = 0;
+        state.nodes[nodeIndex].axis = (uint16_t)axis;
+        buildNode(state, middle, end);
+    }
+}
+
+std::vector<MeshBVHNode> MeshBVH::Build(const std::vector<glm::vec3>& minimums, const std::vector<glm::vec3>& maximums, std::vector<uint32_t>& order)
+{
+    BuildState state{ minimums, maximums, {}, order, {} };
+    state.centroids.resize(minimums.size());
+    for (size_t i = 0; i < minimums.size(); i++)
+        state.centroids[i] = (minimums[i] + maximums[i]) * 0.5f;
+
+    order.resize(minimums.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if (order.empty())
+        return {};
+
+    state.nodes.reserve(2 * (minimums.size() / LeafSize) + 1);
+    buildNode(state, 0, (uint32_t)order.size());
+    return std::move(state.nodes);
+}
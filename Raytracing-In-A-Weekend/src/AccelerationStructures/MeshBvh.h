@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Core/RTWeekend.h"
+
+// Node of a BVH stored as one flat array in depth first order. An inner node's first child directly follows it
+// and its second child is at offset. A leaf holds triangles [offset, offset + count) of the reordered triangle list.
+// The layout has no pointers, so it can be written to disk and used straight from a mapped file.
+struct MeshBVHNode
+{
+    glm::vec3 minimum;
+    uint32_t offset;
+    glm::vec3 maximum;
+    uint16_t count; //0 for inner nodes
+    uint16_t axis; //Split axis of inner nodes, the child on the ray's side of it is visited first
+};
+static_assert(sizeof(MeshBVHNode) == 32, "MeshBVHNode is stored in mesh cache files");
+
+class MeshBVH
+{
+public:
+    static constexpr int LeafSize = 4;
+    static constexpr int MaxDepth = 64; //Traversal stack size, median splits stay far below it
+
+    // Builds the tree over triangles given by their bounds. order receives the triangle index at every position of
+    // the leaf ranges, the caller reorders its triangle data with it.
+    static std::vector<MeshBVHNode> Build(const std::vector<glm::vec3>& minimums, const std::vector<glm::vec3>& maximums, std::vector<uint32_t>& order);
+
+    // Slab test against a node, returns the entry distance or infinity on a miss
+    static float Intersect(const MeshBVHNode& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float tMin, float tMax)
+    {
+        glm::vec3 t0 = (node.minimum - origin) * inverseDirection;
+        glm::vec3 t1 = (node.maximum - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float entry = fmax(fmax(tNear.x, tNear.y), fmax(tNear.z, tMin));
+        float exit = fmin(fmin(tFar.x, tFar.y), fmin(tFar.z, tMax));
+        return entry <= exit ? entry : infinity;
+    }
+};
@@ -0,0 +1,75 @@
+#include "Core/AliasTable.h"
+
+AliasTable::AliasTable(const std::vector<float>& weights)
+    : bins(weights.size())
+{
+    if (weights.empty())
+        return;
+
+    double sum = 0.0;
+    for (float w : weights)
+        sum += w;
+
+    const int n = (int)weights.size();
+    for (int i = 0; i < n; i++)
+    {
+        bins[i].p = sum > 0.0 ? (float)(weights[i] / sum) : 1.0f / n;
+        bins[i].q = 0.0f;
+        bins[i].alias = -1;
+    }
+
+    //Split into bins with less and more than average probability and pair them up
+    std::vector<std::pair<int, float>> under, over;
+    for (int i = 0; i < n; i++)
+    {
+        float pScaled = bins[i].p * n;
+        if (pScaled < 1.0f)
+            under.push_back({ i, pScaled });
+        else
+            over.push_back({ i, pScaled });
+    }
+
+    while (!under.empty() && !over.empty())
+    {
+        std::pair<int, float> un = under.back();
+        std::pair<int, float> ov = over.back();
+        under.pop_back();
+        over.pop_back();
+
+        bins[un.first].q = un.second;
+        bins[un.first].alias = ov.first;
+
+        float pExcess = un.second + ov.second - 1.0f;
+        if (pExcess < 1.0f)
+            under.push_back({ ov.first, pExcess });
+        else
+            over.push_back({ ov.first, pExcess });
+    }
+
+    //Whatever is left over is 1 up to rounding
+    while (!over.empty())
+    {
+        bins[over.back().first].q = 1.0f;
+        bins[over.back().first].alias = -1;
+        over.pop_back();
+    }
+    while (!under.empty())
+    {
+        bins[under.back().first].q = 1.0f;
+        bins[under.back().first].alias = -1;
+        under.pop_back();
+    }
+}
+
+int AliasTable::Sample(float u) const
+{
+    const int n = (int)bins.size();
+    int offset = (int)(u * n);
+    if (offset >= n)
+        offset = n - 1;
+    float up = u * n - offset;
+
+    if (up < bins[offset].q)
+        return offset;
+    return bins[offset].alias;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Walker/Vose alias method, draws an index proportional to its weight in O(1)
+class AliasTable
+{
+public:
+    AliasTable() = default;
+    AliasTable(const std::vector<float>& weights);
+
+    int Sample(float u) const;
+    float Pmf(int index) const { return bins[index].p; }
+    size_t Size() const { return bins.size(); }
+
+private:
+    struct Bin
+    {
+        float q; //Probability of keeping this bin instead of jumping to its alias
+        float p; //Normalized probability of this index
+        int alias;
+    };
+
+    std::vector<Bin> bins;
+};
@@ -22,6 +22,13 @@ public:
 		lowerLeftCorner = origin - horizontal / 2.0f - vertical / 2.0f - focusDist * w;
 
 		lensRadius = aperture / 2;
+		pixelSpread = 0.0f;
+	}
+
+	// Angle covered by one pixel, the initial spread of every camera ray's cone
+	void SetImageHeight(int imageHeight)
+	{
+		pixelSpread = glm::length(vertical) / (glm::length(lowerLeftCorner + horizontal / 2.0f + vertical / 2.0f - origin) * imageHeight);
 	}
 
 	Ray GetRay(float s, float t) const
@@ -29,12 +36,15 @@ public:
 		glm::vec3 rd = lensRadius * randomInUnitDisk();
 		glm::vec3 offset = u * rd.x + v * rd.y;
 
-		return Ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset);
+		Ray ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset);
+		ray.coneSpread = pixelSpread;
+		return ray;
 	}
 
 public:
 	glm::vec3 origin, lowerLeftCorner, horizontal, vertical;
 	glm::vec3 u, v, w;
 	float lensRadius;
+	float pixelSpread = 0.0f;
 
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include "Core/DirtyRegionTracker.h"
+
+void DirtyRegionTracker::Add(const DirtyRect& rect)
+{
+	if (rect.x1 <= rect.x0 || rect.y1 <= rect.y0)
+		return;
+	const std::lock_guard<std::mutex> lock(mMutex);
+	mRects.push_back(rect);
+}
+
+std::vector<DirtyRect> DirtyRegionTracker::Take()
+{
+	std::vector<DirtyRect> rects;
+	{
+		const std::lock_guard<std::mutex> lock(mMutex);
+		rects.swap(mRects);
+	}
+	merge(rects);
+	return rects;
+}
+
+void DirtyRegionTracker::Clear()
+{
+	const std::lock_guard<std::mutex> lock(mMutex);
+	mRects.clear();
+}
+
+bool DirtyRegionTracker::Empty()
+{
+	const std::lock_guard<std::mutex> lock(mMutex);
+	return mRects.empty();
+}
+
+void DirtyRegionTracker::merge(std::vector<DirtyRect>& rects)
+{
+	if (rects.size() < 2)
+		return;
+
+	//Drop duplicates, then join neighbours in a row into strips and stacked strips of equal width into blocks
+	std::sort(rects.begin(), rects.end(), [](const DirtyRect& a, const DirtyRect& b)
+		{
+			if (a.y0 != b.y0) return a.y0 < b.y0;
+			if (a.y1 != b.y1) return a.y1 < b.y1;
+			return a.x0 < b.x0;
+		});
+
+	std::vector<DirtyRect> strips;
+	for (const DirtyRect& rect : rects)
+	{
+		if (!strips.empty())
+		{
+			DirtyRect& last = strips.back();
+			if (last.y0 == rect.y0 && last.y1 == rect.y1 && rect.x0 <= last.x1)
+			{
+				last.x1 = std::max(last.x1, rect.x1);
+				continue;
+			}
+		}
+		strips.push_back(rect);
+	}
+
+	std::sort(strips.begin(), strips.end(), [](const DirtyRect& a, const DirtyRect& b)
+		{
+			if (a.x0 != b.x0) return a.x0 < b.x0;
+			if (a.x1 != b.x1) return a.x1 < b.x1;
+			return a.y0 < b.y0;
+		});
+
+	rects.clear();
+	for (const DirtyRect& strip : strips)
+	{
+		if (!rects.empty())
+		{
+			DirtyRect& last = rects.back();
+			if (last.x0 == strip.x0 && last.x1 == strip.x1 && strip.y0 <= last.y1)
+			{
+				last.y1 = std::max(last.y1, strip.y1);
+				continue;
+			}
+		}
+		rects.push_back(strip);
+	}
+}
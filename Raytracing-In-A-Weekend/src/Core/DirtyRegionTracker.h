@@ -0,0 +1,30 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+// Pixel rectangle [x0, x1) x [y0, y1)
+struct DirtyRect
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+// Collects the parts of an image that changed since the consumer last looked.
+// Producers may add from any thread; Take() hands everything over with adjacent rectangles merged.
+class DirtyRegionTracker
+{
+public:
+	void Add(const DirtyRect& rect);
+
+	// Everything added since the last call, coalesced into as few rectangles as the simple merge finds
+	std::vector<DirtyRect> Take();
+
+	void Clear();
+	bool Empty();
+
+private:
+	std::mutex mMutex;
+	std::vector<DirtyRect> mRects;
+
+	static void merge(std::vector<DirtyRect>& rects);
+};
@@ -0,0 +1,780 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <thread>
+#include "Core/GltfLoader.h"
+#include "Core/Json.h"
+
+namespace
+{
+	const uint32_t glbMagic = 0x46546C67; //"glTF"
+	const uint32_t glbJsonChunk = 0x4E4F534A;
+	const uint32_t glbBinaryChunk = 0x004E4942;
+	const int maxNodeDepth = 256;
+
+	enum ComponentType
+	{
+		Byte = 5120,
+		UnsignedByte = 5121,
+		Short = 5122,
+		UnsignedShort = 5123,
+		UnsignedInt = 5125,
+		Float = 5126
+	};
+
+	int componentBytes(int componentType)
+	{
+		switch (componentType)
+		{
+		case Byte: case UnsignedByte: return 1;
+		case Short: case UnsignedShort: return 2;
+		case UnsignedInt: case Float: return 4;
+		default: return 0;
+		}
+	}
+
+	int componentCount(const std::string& type)
+	{
+		if (type == "SCALAR")
+			return 1;
+		if (type == "VEC2")
+			return 2;
+		if (type == "VEC3")
+			return 3;
+		if (type == "VEC4")
+			return 4;
+		return 0;
+	}
+
+	// Non negative whole number that fits an index, false for anything else
+	bool toIndex(const JsonValue& value, size_t& out)
+	{
+		double number = value.AsNumber(-1.0);
+		if (!value.IsNumber() || number < 0.0 || number > 4294967295.0 || number != (double)(size_t)number)
+			return false;
+		out = (size_t)number;
+		return true;
+	}
+
+	std::string decodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+			{
+				decoded += (char)std::stoi(uri.substr(i + 1, 2), nullptr, 16);
+				i += 2;
+			}
+			else
+				decoded += uri[i];
+		}
+		return decoded;
+	}
+
+	//A .glb holds the JSON and the first buffer as chunks of one file, a .gltf is all JSON
+	bool findJson(const MappedFile& file, const char*& json, size_t& jsonLength, std::vector<std::pair<const uint8_t*, size_t>>& buffers)
+	{
+		json = reinterpret_cast<const char*>(file.Data());
+		jsonLength = file.Size();
+		uint32_t header[3] = {};
+		if (file.Size() >= 20)
+			memcpy(header, file.Data(), 12);
+		if (header[0] != glbMagic)
+			return true;
+
+		size_t length = std::min<size_t>(header[2], file.Size());
+		size_t offset = 12;
+		json = nullptr;
+		while (offset + 8 <= length)
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, file.Data() + offset, 8);
+			offset += 8;
+			if (chunk[0] > length - offset)
+				break;
+			if (chunk[1] == glbJsonChunk && !json)
+			{
+				json = reinterpret_cast<const char*>(file.Data() + offset);
+				jsonLength = chunk[0];
+			}
+			else if (chunk[1] == glbBinaryChunk && buffers.empty())
+				buffers.push_back({ file.Data() + offset, chunk[0] });
+			offset += (chunk[0] + 3) & ~3u;
+		}
+		return json != nullptr;
+	}
+
+	std::string directoryOf(const std::string& path)
+	{
+		return path.find_last_of('/') == std::string::npos ? "." : path.substr(0, path.find_last_of('/'));
+	}
+
+	glm::mat4 nodeTransform(const JsonValue& node)
+	{
+		glm::mat4 transform(1.0f);
+		const JsonValue& matrix = node["matrix"];
+		if (matrix.Size() == 16)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				transform[column] = glm::vec4((float)matrix[4 * column].AsNumber(), (float)matrix[4 * column + 1].AsNumber(),
+					(float)matrix[4 * column + 2].AsNumber(), (float)matrix[4 * column + 3].AsNumber());
+			}
+			return transform;
+		}
+
+		//Translation * rotation * scale, the rotation is a unit quaternion stored as x, y, z, w
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+		float x = (float)r[0].AsNumber(0.0), y = (float)r[1].AsNumber(0.0), z = (float)r[2].AsNumber(0.0), w = (float)r[3].AsNumber(1.0);
+		glm::vec3 scale((float)s[0].AsNumber(1.0), (float)s[1].AsNumber(1.0), (float)s[2].AsNumber(1.0));
+		transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * scale.x;
+		transform[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * scale.y;
+		transform[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scale.z;
+		transform[3] = glm::vec4((float)t[0].AsNumber(0.0), (float)t[1].AsNumber(0.0), (float)t[2].AsNumber(0.0), 1.0f);
+		return transform;
+	}
+
+	// Runs job(0) to job(count - 1) on as many threads as there are cores
+	void runParallel(size_t count, const std::function<void(size_t)>& job)
+	{
+		int workerCount = (int)std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count));
+		std::atomic<size_t> next(0);
+		std::vector<std::future<void>> workers;
+		for (int w = 0; w < workerCount; w++)
+		{
+			workers.push_back(std::async(std::launch::async, [&job, &next, count]
+				{
+					for (size_t i = next++; i < count; i = next++)
+						job(i);
+				}));
+		}
+		for (std::future<void>& worker : workers)
+			worker.get();
+	}
+}
+
+glm::vec4 GltfModel::Accessor::Read(size_t index) const
+{
+	const uint8_t* element = data + index * stride;
+	glm::vec4 value(0.0f, 0.0f, 0.0f, 0.0f);
+	for (int c = 0; c < components; c++)
+	{
+		switch (componentType)
+		{
+		case Float:
+			memcpy(&value[c], element + 4 * c, 4);
+			break;
+		case UnsignedByte:
+			value[c] = normalized ? element[c] / 255.0f : element[c];
+			break;
+		case Byte:
+			value[c] = normalized ? std::max((int8_t)element[c] / 127.0f, -1.0f) : (int8_t)element[c];
+			break;
+		case UnsignedShort:
+		{
+			uint16_t component;
+			memcpy(&component, element + 2 * c, 2);
+			value[c] = normalized ? component / 65535.0f : component;
+			break;
+		}
+		case Short:
+		{
+			int16_t component;
+			memcpy(&component, element + 2 * c, 2);
+			value[c] = normalized ? std::max(component / 32767.0f, -1.0f) : component;
+			break;
+		}
+		case UnsignedInt:
+		{
+			uint32_t component;
+			memcpy(&component, element + 4 * c, 4);
+			value[c] = (float)component;
+			break;
+		}
+		}
+	}
+	return value;
+}
+
+uint32_t GltfModel::Accessor::ReadIndex(size_t index) const
+{
+	const uint8_t* element = data + index * stride;
+	if (componentType == UnsignedByte)
+		return element[0];
+	if (componentType == UnsignedShort)
+	{
+		uint16_t value;
+		memcpy(&value, element, 2);
+		return value;
+	}
+	uint32_t value;
+	memcpy(&value, element, 4);
+	return value;
+}
+
+bool GltfModel::Handles(const std::string& path)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return path.find('.') != std::string::npos && (extension == "gltf" || extension == "glb");
+}
+
+bool GltfModel::BufferPaths(const std::string& path, std::vector<std::string>& paths)
+{
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+	if (!file)
+		return false;
+	const char* json;
+	size_t jsonLength;
+	std::vector<std::pair<const uint8_t*, size_t>> binary;
+	JsonValue document;
+	std::string error;
+	if (!findJson(*file, json, jsonLength, binary) || !JsonValue::Parse(json, jsonLength, document, error))
+		return false;
+
+	//Same uris resolve maps, embedded buffers and the .glb binary chunk are part of the file itself
+	const JsonValue& buffers = document["buffers"];
+	for (size_t i = 0; i < buffers.Size(); i++)
+	{
+		if (!buffers[i].Has("uri"))
+			continue;
+		std::string uri = buffers[i]["uri"].AsString();
+		if (uri.rfind("data:", 0) != 0)
+			paths.push_back(directoryOf(path) + '/' + decodeUri(uri));
+	}
+	return true;
+}
+
+std::unique_ptr<GltfModel> GltfModel::Open(const std::string& path, std::string& error)
+{
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+	if (!file)
+	{
+		error = "can't read " + path;
+		return nullptr;
+	}
+
+	std::unique_ptr<GltfModel> model(new GltfModel());
+	model->mFiles.push_back(file);
+
+	const char* json;
+	size_t jsonLength;
+	if (!findJson(*file, json, jsonLength, model->mBuffers))
+	{
+		error = "binary glTF without a JSON chunk";
+		return nullptr;
+	}
+
+	JsonValue document;
+	if (!JsonValue::Parse(json, jsonLength, document, error))
+		return nullptr;
+	if (document["asset"]["version"].AsString().substr(0, 2) != "2.")
+	{
+		error = "not a glTF 2.0 file";
+		return nullptr;
+	}
+
+	//Quantized attributes are read like any other accessor, material extensions only change shading details.
+	//Everything else that is required, like compressed geometry, is left to assimp.
+	const JsonValue& required = document["extensionsRequired"];
+	for (size_t i = 0; i < required.Size(); i++)
+	{
+		const std::string& extension = required[i].AsString();
+		if (extension != "KHR_mesh_quantization" && extension.rfind("KHR_materials_", 0) != 0)
+		{
+			error = "requires " + extension;
+			return nullptr;
+		}
+	}
+
+	if (!model->resolve(document, directoryOf(path), error))
+		return nullptr;
+	return model;
+}
+
+bool GltfModel::resolveAccessor(const JsonValue& document, const JsonValue& index, Accessor& out, std::string& error) const
+{
+	size_t accessorIndex, viewIndex, bufferIndex;
+	if (!toIndex(index, accessorIndex) || !document["accessors"][accessorIndex].IsObject())
+	{
+		error = "invalid accessor";
+		return false;
+	}
+	const JsonValue& accessor = document["accessors"][accessorIndex];
+	if (accessor.Has("sparse") || !toIndex(accessor["bufferView"], viewIndex))
+	{
+		error = "sparse or empty accessors";
+		return false;
+	}
+
+	out.componentType = (int)accessor["componentType"].AsNumber();
+	out.components = componentCount(accessor["type"].AsString());
+	out.normalized = accessor["normalized"].AsBool();
+	size_t elementBytes = (size_t)componentBytes(out.componentType) * out.components;
+	size_t accessorOffset = 0;
+	if (elementBytes == 0 || !toIndex(accessor["count"], out.count) || (accessor.Has("byteOffset") && !toIndex(accessor["byteOffset"], accessorOffset)))
+	{
+		error = "unsupported accessor layout";
+		return false;
+	}
+
+	const JsonValue& view = document["bufferViews"][viewIndex];
+	size_t viewOffset = 0, viewLength = 0;
+	out.stride = elementBytes;
+	if (!view.IsObject() || !toIndex(view["buffer"], bufferIndex) || bufferIndex >= mBuffers.size() || !toIndex(view["byteLength"], viewLength)
+		|| (view.Has("byteOffset") && !toIndex(view["byteOffset"], viewOffset)) || (view.Has("byteStride") && !toIndex(view["byteStride"], out.stride)))
+	{
+		error = "invalid buffer view";
+		return false;
+	}
+
+	//Everything an accessor reads has to lie in its view and the view in its buffer
+	size_t bufferSize = mBuffers[bufferIndex].second;
+	bool inside = out.stride >= elementBytes && viewOffset <= bufferSize && viewLength <= bufferSize - viewOffset;
+	if (inside && out.count > 0)
+		inside = accessorOffset <= viewLength && elementBytes <= viewLength - accessorOffset && out.count - 1 <= (viewLength - accessorOffset - elementBytes) / out.stride;
+	if (!inside)
+	{
+		error = "accessor outside of its buffer";
+		return false;
+	}
+	out.data = mBuffers[bufferIndex].first + viewOffset + accessorOffset;
+	return true;
+}
+
+bool GltfModel::resolve(const JsonValue& document, const std::string& directory, std::string& error)
+{
+	//Buffers are mapped, not read, pages of unused buffers are never touched
+	const JsonValue& buffers = document["buffers"];
+	for (size_t i = 0; i < buffers.Size(); i++)
+	{
+		const JsonValue& buffer = buffers[i];
+		size_t byteLength = 0;
+		if (!toIndex(buffer["byteLength"], byteLength))
+		{
+			error = "invalid buffer";
+			return false;
+		}
+		if (!buffer.Has("uri"))
+		{
+			//Only the first buffer of a .glb may omit its uri, it is the binary chunk read in Open
+			if (i != 0 || mBuffers.size() != 1 || mBuffers[0].second < byteLength)
+			{
+				error = "buffer without data";
+				return false;
+			}
+			mBuffers[0].second = byteLength;
+			continue;
+		}
+		std::string uri = buffer["uri"].AsString();
+		if (uri.rfind("data:", 0) == 0)
+		{
+			error = "embedded base64 buffers";
+			return false;
+		}
+		std::shared_ptr<MappedFile> file = MappedFile::Open(directory + '/' + decodeUri(uri));
+		if (!file || file->Size() < byteLength)
+		{
+			error = "can't read buffer " + uri;
+			return false;
+		}
+		mFiles.push_back(file);
+		if (i == 0 && !mBuffers.empty())
+			mBuffers[0] = { file->Data(), byteLength };
+		else
+			mBuffers.push_back({ file->Data(), byteLength });
+	}
+
+	//Roots of the default scene, or every node nobody references if the file has no scenes
+	const JsonValue& nodes = document["nodes"];
+	std::vector<size_t> roots;
+	size_t sceneIndex = 0;
+	toIndex(document["scene"], sceneIndex);
+	const JsonValue& scene = document["scenes"][sceneIndex];
+	if (scene.IsObject())
+	{
+		for (size_t i = 0; i < scene["nodes"].Size(); i++)
+		{
+			size_t root;
+			if (toIndex(scene["nodes"][i], root))
+				roots.push_back(root);
+		}
+	}
+	else
+	{
+		std::vector<bool> isChild(nodes.Size(), false);
+		for (size_t n = 0; n < nodes.Size(); n++)
+		{
+			for (size_t c = 0; c < nodes[n]["children"].Size(); c++)
+			{
+				size_t child;
+				if (toIndex(nodes[n]["children"][c], child) && child < isChild.size())
+					isChild[child] = true;
+			}
+		}
+		for (size_t n = 0; n < nodes.Size(); n++)
+		{
+			if (!isChild[n])
+				roots.push_back(n);
+		}
+	}
+
+	struct PendingNode
+	{
+		size_t node;
+		glm::mat4 parentTransform;
+		int depth;
+	};
+	std::vector<PendingNode> pending;
+	for (size_t r = roots.size(); r-- > 0;)
+		pending.push_back({ roots[r], glm::mat4(1.0f), 0 });
+
+	std::vector<bool> visited(nodes.Size(), false);
+	std::vector<std::vector<size_t>> meshPrimitives(document["meshes"].Size());
+	std::vector<bool> meshResolved(document["meshes"].Size(), false);
+	std::vector<int> materialSlots(document["materials"].Size() + 1, -1); //The last slot stands for the default material
+	std::vector<size_t> usedMaterials;
+	std::vector<std::pair<size_t, glm::mat4>> placedMeshes;
+	while (!pending.empty())
+	{
+		PendingNode current = pending.back();
+		pending.pop_back();
+		if (current.node >= nodes.Size() || visited[current.node] || current.depth > maxNodeDepth)
+		{
+			error = "node hierarchy is not a tree";
+			return false;
+		}
+		visited[current.node] = true;
+
+		const JsonValue& node = nodes[current.node];
+		glm::mat4 transform = current.parentTransform * nodeTransform(node);
+		size_t meshIndex;
+		if (toIndex(node["mesh"], meshIndex) && meshIndex < meshPrimitives.size())
+			placedMeshes.push_back({ meshIndex, transform });
+
+		const JsonValue& children = node["children"];
+		for (size_t c = children.Size(); c-- > 0;)
+		{
+			size_t child;
+			if (!toIndex(children[c], child))
+			{
+				error = "invalid child node";
+				return false;
+			}
+			pending.push_back({ child, transform, current.depth + 1 });
+		}
+	}
+
+	//Every mesh is resolved once, however often it is placed
+	size_t primitiveCount = 0;
+	for (const std::pair<size_t, glm::mat4>& placed : placedMeshes)
+	{
+		if (!meshResolved[placed.first])
+		{
+			meshResolved[placed.first] = true;
+			primitiveCount += document["meshes"][placed.first]["primitives"].Size();
+		}
+	}
+	mPrimitives.clear();
+	mPrimitives.reserve(primitiveCount); //Instances point into this list
+	std::fill(meshResolved.begin(), meshResolved.end(), false);
+	for (const std::pair<size_t, glm::mat4>& placed : placedMeshes)
+	{
+		if (meshResolved[placed.first])
+			continue;
+		meshResolved[placed.first] = true;
+
+		const JsonValue& primitives = document["meshes"][placed.first]["primitives"];
+		for (size_t p = 0; p < primitives.Size(); p++)
+		{
+			const JsonValue& primitive = primitives[p];
+			int mode = (int)primitive["mode"].AsNumber(4.0);
+			if (mode < 4)
+				continue; //Points and lines have no surface
+			if (mode != 4)
+			{
+				error = "triangle strips and fans";
+				return false;
+			}
+
+			Primitive resolved;
+			const JsonValue& attributes = primitive["attributes"];
+			if (!resolveAccessor(document, attributes["POSITION"], resolved.positions, error) || resolved.positions.components != 3)
+			{
+				error = "primitive without usable positions";
+				return false;
+			}
+			size_t vertexCount = resolved.positions.count;
+			if ((attributes.Has("NORMAL") && (!resolveAccessor(document, attributes["NORMAL"], resolved.normals, error) || resolved.normals.components != 3 || resolved.normals.count != vertexCount))
+				|| (attributes.Has("TEXCOORD_0") && (!resolveAccessor(document, attributes["TEXCOORD_0"], resolved.uvs, error) || resolved.uvs.components != 2 || resolved.uvs.count != vertexCount))
+				|| (attributes.Has("TANGENT") && (!resolveAccessor(document, attributes["TANGENT"], resolved.tangents, error) || resolved.tangents.components != 4 || resolved.tangents.count != vertexCount)))
+			{
+				error = "invalid vertex attribute";
+				return false;
+			}
+
+			if (primitive.Has("indices"))
+			{
+				if (!resolveAccessor(document, primitive["indices"], resolved.indices, error) || resolved.indices.components != 1
+					|| (resolved.indices.componentType != UnsignedByte && resolved.indices.componentType != UnsignedShort && resolved.indices.componentType != UnsignedInt))
+				{
+					error = "invalid index accessor";
+					return false;
+				}
+				for (size_t i = 0; i < resolved.indices.count; i++)
+				{
+					if (resolved.indices.ReadIndex(i) >= vertexCount)
+					{
+						error = "index out of range";
+						return false;
+					}
+				}
+			}
+
+			size_t materialIndex = materialSlots.size() - 1;
+			if (primitive.Has("material") && (!toIndex(primitive["material"], materialIndex) || materialIndex >= materialSlots.size() - 1))
+			{
+				error = "invalid material";
+				return false;
+			}
+			if (materialSlots[materialIndex] < 0)
+			{
+				materialSlots[materialIndex] = (int)usedMaterials.size();
+				usedMaterials.push_back(materialIndex);
+			}
+			resolved.material = (uint32_t)materialSlots[materialIndex];
+
+			mPrimitives.push_back(resolved);
+			meshPrimitives[placed.first].push_back(mPrimitives.size() - 1);
+		}
+	}
+
+	for (const std::pair<size_t, glm::mat4>& placed : placedMeshes)
+	{
+		for (size_t p : meshPrimitives[placed.first])
+		{
+			const Primitive& primitive = mPrimitives[p];
+			size_t triangles = (primitive.indices.data ? primitive.indices.count : primitive.positions.count) / 3;
+			mInstances.push_back({ &primitive, placed.second, mVertexCount, mTriangleCount });
+			mVertexCount += primitive.positions.count;
+			mTriangleCount += triangles;
+		}
+	}
+	if (mVertexCount > UINT32_MAX || mTriangleCount == 0)
+	{
+		error = mTriangleCount == 0 ? "no triangles" : "too many vertices";
+		return false;
+	}
+
+	//Texture slots the renderer knows, paths of embedded images stay empty and the slot unused
+	auto texturePath = [&document](const JsonValue& textureInfo)
+	{
+		size_t textureIndex, imageIndex;
+		if (!toIndex(textureInfo["index"], textureIndex) || !toIndex(document["textures"][textureIndex]["source"], imageIndex))
+			return std::string();
+		const JsonValue& image = document["images"][imageIndex];
+		const std::string& uri = image["uri"].AsString();
+		if (uri.empty() || uri.rfind("data:", 0) == 0)
+			return std::string();
+		return decodeUri(uri);
+	};
+	for (size_t materialIndex : usedMaterials)
+	{
+		MeshMaterialDesc desc;
+		const JsonValue& material = document["materials"][materialIndex];
+		if (material.IsObject())
+		{
+			const JsonValue& pbr = material["pbrMetallicRoughness"];
+			const JsonValue& baseColor = pbr["baseColorFactor"];
+			desc.baseColor = glm::vec3((float)baseColor[0].AsNumber(1.0), (float)baseColor[1].AsNumber(1.0), (float)baseColor[2].AsNumber(1.0));
+			const JsonValue& emissive = material["emissiveFactor"];
+			float strength = (float)material["extensions"]["KHR_materials_emissive_strength"]["emissiveStrength"].AsNumber(1.0);
+			desc.emissiveFactor = glm::vec3((float)emissive[0].AsNumber(), (float)emissive[1].AsNumber(), (float)emissive[2].AsNumber()) * strength;
+			desc.twoSided = material["doubleSided"].AsBool();
+			desc.textures[(int)MeshTextureSlot::Diffuse] = texturePath(pbr["baseColorTexture"]);
+			desc.textures[(int)MeshTextureSlot::Roughness] = texturePath(pbr["metallicRoughnessTexture"]);
+			desc.textures[(int)MeshTextureSlot::Normal] = texturePath(material["normalTexture"]);
+			desc.textures[(int)MeshTextureSlot::Emissive] = texturePath(material["emissiveTexture"]);
+		}
+		mMaterials.push_back(desc);
+	}
+	return true;
+}
+
+void GltfModel::LoadGeometry(const glm::mat4& model, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& materialIndices) const
+{
+	vertices.resize(mVertexCount);
+	indices.resize(3 * mTriangleCount);
+	materialIndices.resize(mTriangleCount);
+
+	//Vertices and triangles of big primitives are split into chunks so they are shared out too
+	const size_t chunkSize = 16384;
+	struct Chunk
+	{
+		const Instance* instance;
+		bool triangles;
+		size_t first, last;
+	};
+	std::vector<Chunk> chunks;
+	for (const Instance& instance : mInstances)
+	{
+		size_t vertexCount = instance.primitive->positions.count;
+		size_t triangleCount = (instance.primitive->indices.data ? instance.primitive->indices.count : vertexCount) / 3;
+		for (size_t v = 0; v < vertexCount; v += chunkSize)
+			chunks.push_back({ &instance, false, v, std::min(v + chunkSize, vertexCount) });
+		for (size_t t = 0; t < triangleCount; t += chunkSize)
+			chunks.push_back({ &instance, true, t, std::min(t + chunkSize, triangleCount) });
+	}
+	runParallel(chunks.size(), [&](size_t c)
+		{
+			const Chunk& chunk = chunks[c];
+			if (chunk.triangles)
+				convertTriangles(*chunk.instance, model, chunk.first, chunk.last, indices.data(), materialIndices.data());
+			else
+				convertVertices(*chunk.instance, model, chunk.first, chunk.last, vertices.data() + chunk.instance->firstVertex);
+		});
+
+	std::vector<const Instance*> incomplete;
+	for (const Instance& instance : mInstances)
+	{
+		if (!instance.primitive->normals.data || (instance.primitive->uvs.data && !instance.primitive->tangents.data))
+			incomplete.push_back(&instance);
+	}
+	runParallel(incomplete.size(), [&](size_t i) { generateFrames(*incomplete[i], vertices, indices); });
+}
+
+void GltfModel::convertVertices(const Instance& instance, const glm::mat4& model, size_t first, size_t last, Vertex* out) const
+{
+	const Primitive& primitive = *instance.primitive;
+	glm::mat4 world = model * instance.transform;
+	glm::mat3 directionMatrix(world);
+	glm::mat3 normalMatrix(glm::transpose(glm::inverse(world)));
+
+	for (size_t v = first; v < last; v++)
+	{
+		Vertex& vertex = out[v];
+		glm::vec4 position = primitive.positions.Read(v);
+		vertex.position = glm::vec3(world * glm::vec4(position.x, position.y, position.z, 1.0f));
+
+		//Zero normals and a negative tangent mark what generateFrames fills in, as with the assimp import
+		vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		glm::vec3 normal(0.0f, 0.0f, 0.0f);
+		if (primitive.normals.data)
+		{
+			normal = glm::normalize(glm::vec3(primitive.normals.Read(v)));
+			vertex.normal = normalMatrix * normal;
+		}
+
+		//glTF puts the uv origin at the top left, the textures are sampled from the bottom left
+		vertex.textureCoord = glm::vec3(-1.0f, 0.0f, 0.0f);
+		if (primitive.uvs.data)
+		{
+			glm::vec4 uv = primitive.uvs.Read(v);
+			vertex.textureCoord = glm::vec3(uv.x, 1.0f - uv.y, 0.0f);
+		}
+
+		vertex.tangent = glm::vec3(-1.0f, 0.0f, 0.0f);
+		vertex.bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+		if (primitive.tangents.data)
+		{
+			glm::vec4 tangent = primitive.tangents.Read(v);
+			vertex.tangent = directionMatrix * glm::vec3(tangent);
+			vertex.bitangent = directionMatrix * (glm::cross(normal, glm::vec3(tangent)) * tangent.w);
+		}
+	}
+}
+
+void GltfModel::convertTriangles(const Instance& instance, const glm::mat4& model, size_t first, size_t last, uint32_t* indices, uint32_t* materialIndices) const
+{
+	const Primitive& primitive = *instance.primitive;
+
+	//A mirroring transform turns the winding around, swapping two corners keeps the front faces
+	glm::mat3 world(model * instance.transform);
+	bool mirrored = glm::dot(world[0], glm::cross(world[1], world[2])) < 0.0f;
+	uint32_t base = (uint32_t)instance.firstVertex;
+
+	for (size_t t = first; t < last; t++)
+	{
+		uint32_t corners[3];
+		for (int k = 0; k < 3; k++)
+			corners[k] = base + (primitive.indices.data ? primitive.indices.ReadIndex(3 * t + k) : (uint32_t)(3 * t + k));
+		if (mirrored)
+			std::swap(corners[1], corners[2]);
+
+		size_t triangle = instance.firstTriangle + t;
+		for (int k = 0; k < 3; k++)
+			indices[3 * triangle + k] = corners[k];
+		materialIndices[triangle] = primitive.material;
+	}
+}
+
+void GltfModel::generateFrames(const Instance& instance, std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) const
+{
+	const Primitive& primitive = *instance.primitive;
+	bool needNormals = !primitive.normals.data;
+	bool needTangents = primitive.uvs.data && !primitive.tangents.data;
+	size_t vertexCount = primitive.positions.count;
+	size_t triangleCount = (primitive.indices.data ? primitive.indices.count : vertexCount) / 3;
+	Vertex* out = vertices.data() + instance.firstVertex;
+
+	//Area weighted sums over the triangles around every vertex, in world space
+	std::vector<glm::vec3> normals(needNormals ? vertexCount : 0, glm::vec3(0.0f, 0.0f, 0.0f));
+	std::vector<glm::vec3> tangents(needTangents ? vertexCount : 0, glm::vec3(0.0f, 0.0f, 0.0f));
+	std::vector<glm::vec3> bitangents(needTangents ? vertexCount : 0, glm::vec3(0.0f, 0.0f, 0.0f));
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* corners = indices.data() + 3 * (instance.firstTriangle + t);
+		uint32_t i0 = corners[0] - (uint32_t)instance.firstVertex;
+		uint32_t i1 = corners[1] - (uint32_t)instance.firstVertex;
+		uint32_t i2 = corners[2] - (uint32_t)instance.firstVertex;
+		glm::vec3 edge1 = out[i1].position - out[i0].position;
+		glm::vec3 edge2 = out[i2].position - out[i0].position;
+		if (needNormals)
+		{
+			glm::vec3 faceNormal = glm::cross(edge1, edge2);
+			normals[i0] += faceNormal;
+			normals[i1] += faceNormal;
+			normals[i2] += faceNormal;
+		}
+		if (needTangents)
+		{
+			glm::vec2 deltaUV1 = out[i1].textureCoord - out[i0].textureCoord;
+			glm::vec2 deltaUV2 = out[i2].textureCoord - out[i0].textureCoord;
+			float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+			if (determinant == 0.0f)
+				continue;
+			float f = 1.0f / determinant;
+			glm::vec3 tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * f;
+			glm::vec3 bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * f;
+			for (uint32_t corner : { i0, i1, i2 })
+			{
+				tangents[corner] += tangent;
+				bitangents[corner] += bitangent;
+			}
+		}
+	}
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (needNormals && glm::length(normals[v]) > 0.0f)
+			out[v].normal = glm::normalize(normals[v]);
+		if (needTangents && glm::length(tangents[v]) > 0.0f && glm::length(bitangents[v]) > 0.0f)
+		{
+			//Made orthogonal to the normal like assimp's tangent space
+			glm::vec3 normal = glm::length(out[v].normal) > 0.0f ? glm::normalize(out[v].normal) : glm::vec3(0.0f, 0.0f, 0.0f);
+			glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]);
+			glm::vec3 bitangent = bitangents[v] - normal * glm::dot(normal, bitangents[v]);
+			if (glm::length(tangent) > 0.0f && glm::length(bitangent) > 0.0f)
+			{
+				out[v].tangent = glm::normalize(tangent);
+				out[v].bitangent = glm::normalize(bitangent);
+			}
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Core/Hittable.h"
+#include "Core/MappedFile.h"
+#include "Core/MeshCache.h"
+
+class JsonValue;
+
+// glTF 2.0 model read without assimp. Open parses the JSON once, maps the buffers and checks every accessor,
+// LoadGeometry then reads the attributes straight from the mapping into the mesh's own buffers.
+// Files using features this loader doesn't cover fail to open, the caller falls back to assimp for them.
+class GltfModel
+{
+public:
+	// .gltf with external buffers, or binary .glb
+	static bool Handles(const std::string& path);
+	// Appends the files the model's external buffers are read from, false if the file can't be parsed
+	static bool BufferPaths(const std::string& path, std::vector<std::string>& paths);
+	// nullptr with a reason in error if the file can't be read or needs an unsupported feature
+	static std::unique_ptr<GltfModel> Open(const std::string& path, std::string& error);
+
+	// Materials used by the default scene, in the numbering of the material indices LoadGeometry returns
+	const std::vector<MeshMaterialDesc>& Materials() const { return mMaterials; }
+
+	// Appends the world space vertices and triangles of every mesh instance in the default scene.
+	// Missing normals and tangents are generated, uvs are flipped to the convention of the texture loader.
+	void LoadGeometry(const glm::mat4& model, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& materialIndices) const;
+
+private:
+	// Typed view of an accessor inside a mapped buffer, bounds were checked when it was resolved
+	struct Accessor
+	{
+		const uint8_t* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		int componentType = 0;
+		int components = 0;
+		bool normalized = false;
+
+		glm::vec4 Read(size_t index) const;
+		uint32_t ReadIndex(size_t index) const;
+	};
+
+	struct Primitive
+	{
+		Accessor positions;
+		Accessor normals; //count is 0 for attributes the file doesn't have
+		Accessor uvs;
+		Accessor tangents;
+		Accessor indices;
+		uint32_t material;
+	};
+
+	// A mesh primitive placed by a node
+	struct Instance
+	{
+		const Primitive* primitive;
+		glm::mat4 transform; //Node to model space
+		size_t firstVertex;
+		size_t firstTriangle;
+	};
+
+	std::vector<std::shared_ptr<MappedFile>> mFiles; //Keeps the mappings alive
+	std::vector<std::pair<const uint8_t*, size_t>> mBuffers;
+	std::vector<Primitive> mPrimitives;
+	std::vector<Instance> mInstances;
+	std::vector<MeshMaterialDesc> mMaterials;
+	size_t mVertexCount = 0;
+	size_t mTriangleCount = 0;
+
+	GltfModel() = default;
+	bool resolve(const JsonValue& document, const std::string& directory, std::string& error);
+	bool resolveAccessor(const JsonValue& document, const JsonValue& index, Accessor& out, std::string& error) const;
+
+	void convertVertices(const Instance& instance, const glm::mat4& model, size_t first, size_t last, Vertex* out) const;
+	void convertTriangles(const Instance& instance, const glm::mat4& model, size_t first, size_t last, uint32_t* indices, uint32_t* materialIndices) const;
+	void generateFrames(const Instance& instance, std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) const;
+};
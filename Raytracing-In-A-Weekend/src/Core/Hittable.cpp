@@ -0,0 +1,53 @@
+#include "Core/Hittable.h"
+#include "Material/Material.h"
+
+bool buildLightTriangle(const Vertex& vert0, const Vertex& vert1, const Vertex& vert2, const std::shared_ptr<Material>& matPtr, LightTriangle& light)
+{
+    if (!matPtr || !matPtr->isEmissive())
+        return false;
+
+    light.p0 = vert0.position;
+    light.p1 = vert1.position;
+    light.p2 = vert2.position;
+    light.uv0 = vert0.textureCoord;
+    light.uv1 = vert1.textureCoord;
+    light.uv2 = vert2.textureCoord;
+    light.twoSided = matPtr->isTwoSided();
+    light.matPtr = matPtr;
+
+    glm::vec3 edge1 = light.p1 - light.p0;
+    glm::vec3 edge2 = light.p2 - light.p0;
+    glm::vec3 crossProduct = glm::cross(edge2, edge1);
+    light.area = 0.5f * glm::length(crossProduct);
+    if (light.area == 0.0f)
+        return false;
+
+    //Same orientation the hit test reports, flipped to agree with the vertex normals if there are any
+    light.normal = glm::normalize(crossProduct);
+    glm::vec3 vertexNormalSum = vert0.normal + vert1.normal + vert2.normal;
+    if (glm::dot(light.normal, vertexNormalSum) < 0.0f)
+        light.normal = -light.normal;
+
+    //Estimate the emitted power from the radiance at the centroid
+    HitRecord rec;
+    rec.p = (light.p0 + light.p1 + light.p2) / 3.0f;
+    glm::vec2 uv = (light.uv0 + light.uv1 + light.uv2) / 3.0f;
+    rec.u = uv.x;
+    rec.v = uv.y;
+    rec.normal = light.normal;
+    rec.frontFace = true;
+    rec.matPtr = matPtr;
+    glm::vec3 radiance = matPtr->emitted(Ray(rec.p + light.normal, -light.normal), rec, rec.u, rec.v, rec.p);
+    light.power = luminance(radiance) * light.area * pi * (light.twoSided ? 2.0f : 1.0f);
+    return true;
+}
+
+void Triangle::CollectEmitters(std::vector<LightTriangle>& emitters)
+{
+    LightTriangle light;
+    if (!buildLightTriangle(vertices[0], vertices[1], vertices[2], matPtr, light))
+        return;
+
+    lightIndex = (int)emitters.size();
+    emitters.push_back(light);
+}
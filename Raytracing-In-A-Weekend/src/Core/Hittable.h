@@ -4,6 +4,8 @@
 
 #include "Core/RTWeekend.h"
 #include "AccelerationStructures/AABB.h"
+#include "AccelerationStructures/LightBvh.h"
+#include "Core/MemoryTracker.h"
 
 class Material;
 
@@ -19,6 +21,8 @@ struct HitRecord
     glm::vec3 tangent;
     glm::vec3 bitangent;
     glm::mat4 modelMatrix;
+    int lightIndex = -1; //Index into the scene's LightBVH if an emitter was hit
+    float textureFootprint = 0.0f; //Width of the ray cone on the surface in uv units, picks the mip level
 
     inline void setFaceNormal(const Ray& r, const glm::vec3& outwardNormal)
     {
@@ -32,6 +36,9 @@ class Hittable
 public:
 	virtual bool Hit(const Ray& r, float tMin, float tMax, HitRecord& rec) const = 0;
     virtual bool BoundingBox(AABB& outputBox) const = 0;
+
+    // Appends all emissive triangles so they can be sampled directly by the LightBVH
+    virtual void CollectEmitters(std::vector<LightTriangle>& emitters) {}
 };
 
 struct Vertex
@@ -43,9 +50,100 @@ struct Vertex
     glm::vec3 bitangent;
 };
 
+// uv length per world length, scales the ray cone's width into texture space
+inline float triangleUvScale(const Vertex& vert0, const Vertex& vert1, const Vertex& vert2)
+{
+    float worldArea = glm::length(glm::cross(vert1.position - vert0.position, vert2.position - vert0.position));
+    glm::vec2 uvEdge1 = vert1.textureCoord - vert0.textureCoord;
+    glm::vec2 uvEdge2 = vert2.textureCoord - vert0.textureCoord;
+    float uvArea = fabs(uvEdge1.x * uvEdge2.y - uvEdge2.x * uvEdge1.y);
+    return worldArea > 0.0f ? sqrt(uvArea / worldArea) : 0.0f;
+}
+
+// Moller-Trumbore test, u and v weight the first and second vertex
+inline bool intersectTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const Ray& r, float tMin, float tMax, float& t, float& u, float& v)
+{
+    const float EPSILON = 1e-8;
+    glm::vec3 edge1 = p1 - p0;
+    glm::vec3 edge2 = p2 - p0;
+    glm::vec3 h = cross(r.direction, edge2);
+    float a = dot(edge1, h);
+    if (a > -EPSILON && a < EPSILON)
+        return false;    // This ray is parallel to this triangle.
+    float f = 1.0f / a;
+    glm::vec3 s = r.origin - p0;
+    u = f * dot(s, h);
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    glm::vec3 q = cross(s, edge1);
+    v = f * dot(r.direction, q);
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    // At this stage we can compute t to find out where the intersection point is on the line.
+    t = f * dot(edge2, q);
+    if (t < tMin || tMax < t)
+        return false; //Intersection is not closer than the closest so far
+    return t > EPSILON; //Otherwise there is a line intersection but not a ray intersection
+}
+
+// Fills the surface of a hit found by intersectTriangle, matPtr, modelMatrix and lightIndex are left to the caller
+inline void triangleHitRecord(const Vertex& vert0, const Vertex& vert1, const Vertex& vert2, float uvScale, const Ray& r, float t, float u, float v, HitRecord& rec)
+{
+    glm::vec3 edge1 = vert1.position - vert0.position;
+    glm::vec3 edge2 = vert2.position - vert0.position;
+    rec.t = t;
+    rec.p = r.At(rec.t);
+
+    if (vert0.normal.x == 0.0f && vert0.normal.y == 0.0f && vert0.normal.z == 0.0f)
+    {
+        rec.setFaceNormal(r, glm::normalize(cross(edge2, edge1)));
+    }
+    else
+    {
+        rec.normal = glm::normalize(u * vert0.normal + v * vert1.normal + (1 - u - v) * vert2.normal);
+        rec.frontFace = dot(r.direction, rec.normal) < 0;
+    }
+    if (vert0.textureCoord.x != -1.0f)
+    {
+        glm::vec3 barycentricCoord = u * vert0.textureCoord + v * vert1.textureCoord + (1 - u - v) * vert2.textureCoord;
+        rec.u = barycentricCoord.x;
+        rec.v = barycentricCoord.y;
+    }
+    else
+    {
+        rec.u = u;
+        rec.v = v;
+    }
+    if (vert0.tangent.x != -1.0f)
+    {
+        rec.tangent = u * vert0.tangent + v * vert1.tangent + (1 - u - v) * vert2.tangent;
+        rec.bitangent = u * vert0.bitangent + v * vert1.bitangent + (1 - u - v) * vert2.bitangent;
+    }
+    else
+    {
+        rec.tangent = vert0.tangent;
+        rec.bitangent = vert0.bitangent;
+    }
+
+    //Cone width where it hits, stretched by how grazing the hit is
+    rec.textureFootprint = 0.0f;
+    if (r.coneSpread > 0.0f || r.coneWidth > 0.0f)
+    {
+        float directionLength = glm::length(r.direction);
+        float width = r.coneWidth + r.coneSpread * t * directionLength;
+        float cosine = fabs(dot(r.direction, glm::normalize(cross(edge1, edge2)))) / directionLength;
+        rec.textureFootprint = width * uvScale / fmax(cosine, 0.05f);
+    }
+}
+
+// Area light for an emissive triangle, false if it is degenerate or not emissive
+bool buildLightTriangle(const Vertex& vert0, const Vertex& vert1, const Vertex& vert2, const std::shared_ptr<Material>& matPtr, LightTriangle& light);
+
 class Triangle : public Hittable
 {
 public:
+    static constexpr MemoryCategory ArenaCategory = MemoryCategory::Triangles;
+
     Triangle() {}
     Triangle(Vertex vert0, Vertex vert1, Vertex vert2, glm::mat4 modelMatrix, std::shared_ptr<Material> material, std::string&& dbgName)
         : modelMatrix(modelMatrix), matPtr(material), debugName(std::move(dbgName))
@@ -53,91 +151,21 @@ public:
         vertices[0] = vert0;
         vertices[1] = vert1;
         vertices[2] = vert2;
+        uvScale = triangleUvScale(vert0, vert1, vert2);
     }
 
     virtual bool Hit(
         const Ray& r, float tMin, float tMax, HitRecord& rec) const override
     {
-        const float EPSILON = 1e-8;
-        glm::vec3 edge1, edge2, h, s, q;
-        float a, f, u, v;
-        edge1 = vertices[1].position - vertices[0].position;
-        edge2 = vertices[2].position - vertices[0].position;
-        h = cross(r.direction, edge2);
-        a = dot(edge1, h);
-        if (a > -EPSILON && a < EPSILON)
-            return false;    // This ray is parallel to this triangle.
-        f = 1.0f / a;
-        s = r.origin - vertices[0].position;
-        u = f * dot(s, h);
-        if (u < 0.0f || u > 1.0f)
-            return false;
-        q = cross(s, edge1);
-        v = f * dot(r.direction, q);
-        if (v < 0.0f || u + v > 1.0f)
+        float t, u, v;
+        if (!intersectTriangle(vertices[0].position, vertices[1].position, vertices[2].position, r, tMin, tMax, t, u, v))
             return false;
-        // At this stage we can compute t to find out where the intersection point is on the line.
-        float t = f * dot(edge2, q);
-        if (t < tMin || tMax < t)
-            return false; //Intersection is not closer than the closest so far
-
-        if (t > EPSILON) // ray intersection
-        {
-            rec.t = t;
-            rec.p = r.At(rec.t);
 
-            if (vertices[0].normal.x == 0.0f && vertices[0].normal.y == 0.0f && vertices[0].normal.z == 0.0f)
-            {
-                rec.setFaceNormal(r, glm::normalize(cross(edge2, edge1)));
-            }
-            else
-            {
-                rec.normal = glm::normalize(u * vertices[0].normal + v * vertices[1].normal + (1 - u - v) * vertices[2].normal);
-            }
-            if(vertices[0].textureCoord.x != -1.0f)
-            {
-                glm::vec3 barycentricCoord = u * vertices[0].textureCoord + v * vertices[1].textureCoord + (1 - u - v) * vertices[2].textureCoord;
-                rec.u = barycentricCoord.x;
-                rec.v = barycentricCoord.y;
-            }
-            else
-            {
-                rec.u = u;
-                rec.v = v;
-            }
-            if(vertices[0].tangent.x != -1.0f)
-            {
-                glm::vec2 deltaUV1 = vertices[2].textureCoord - vertices[0].textureCoord;
-                glm::vec2 deltaUV2 = vertices[1].textureCoord - vertices[0].textureCoord;
-                float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-                glm::vec3 tangent(0.0f, 0.0f, 0.0f);
-                glm::vec3 bitangent(0.0f, 0.0f, 0.0f);
-
-                tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-                tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-                tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-                bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-                bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-                bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-                rec.tangent = tangent;
-                rec.bitangent = bitangent;
-
-                rec.tangent = u * vertices[0].tangent + v * vertices[1].tangent + (1 - u - v) * vertices[2].tangent;
-                rec.bitangent = u * vertices[0].bitangent + v * vertices[1].bitangent + (1 - u - v) * vertices[2].bitangent;
-            }
-            else
-            {
-                rec.tangent = vertices[0].tangent;
-                rec.bitangent = vertices[0].bitangent;
-            }
-            rec.modelMatrix = modelMatrix;
-            rec.matPtr = matPtr;
-            return true;
-        }
-        else // This means that there is a line intersection but not a ray intersection.
-            return false;
+        triangleHitRecord(vertices[0], vertices[1], vertices[2], uvScale, r, t, u, v, rec);
+        rec.modelMatrix = modelMatrix;
+        rec.matPtr = matPtr;
+        rec.lightIndex = lightIndex;
+        return true;
     }
 
     virtual bool BoundingBox(AABB& outputBox) const
@@ -145,9 +173,9 @@ public:
         float xMin = infinity;
         float yMin = infinity;
         float zMin = infinity;
-        float xMax = 1e-8;
-        float yMax = 1e-8;
-        float zMax = 1e-8;
+        float xMax = -infinity;
+        float yMax = -infinity;
+        float zMax = -infinity;
 
         if (vertices[0].position.x < xMin)
             xMin = vertices[0].position.x;
@@ -212,11 +240,15 @@ public:
         return true;
     }
 
+    virtual void CollectEmitters(std::vector<LightTriangle>& emitters) override;
+
 public:
     Vertex vertices[3];
     glm::mat4 modelMatrix; //The model matrix of the mesh this triangle belongs to
     std::shared_ptr<Material> matPtr;
     std::string debugName;
+    int lightIndex = -1;
+    float uvScale = 0.0f;
 };
 
 class Sphere : public Hittable
@@ -250,6 +282,7 @@ public:
         glm::vec3 outwardNormal = (rec.p - center) / radius;
         rec.setFaceNormal(r, outwardNormal);
         rec.matPtr = matPtr;
+        rec.lightIndex = -1;
 
         return true;
     }
@@ -312,6 +345,12 @@ public:
         return true;
     }
 
+    virtual void CollectEmitters(std::vector<LightTriangle>& emitters) override
+    {
+        for (const auto& object : objects)
+            object->CollectEmitters(emitters);
+    }
+
     std::vector<std::shared_ptr<Hittable>> objects;
 };
 
@@ -395,6 +434,11 @@ public:
         return true;
     }
 
+    virtual void CollectEmitters(std::vector<LightTriangle>& emitters) override
+    {
+        sides.CollectEmitters(emitters);
+    }
+
 public:
     glm::vec3 boxMin;
     glm::vec3 boxMax;
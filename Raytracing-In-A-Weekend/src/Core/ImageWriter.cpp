@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cstring>
+#include "Core/ImageWriter.h"
+
+static uint32_t crcTable[256];
+
+static void initCrcTable()
+{
+	static bool initialized = false;
+	if (initialized)
+		return;
+	for (uint32_t n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		crcTable[n] = c;
+	}
+	initialized = true;
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+PngWriter::~PngWriter()
+{
+	if (mFile.is_open())
+		mFile.close();
+}
+
+void PngWriter::writeChunk(const char* type, const uint8_t* data, size_t size)
+{
+	std::vector<uint8_t> header;
+	putBigEndian(header, (uint32_t)size);
+	header.insert(header.end(), type, type + 4);
+	mFile.write((const char*)header.data(), header.size());
+	if (size > 0)
+		mFile.write((const char*)data, size);
+
+	uint32_t crc = updateCrc(0xFFFFFFFFu, (const uint8_t*)type, 4);
+	crc = updateCrc(crc, data, size) ^ 0xFFFFFFFFu;
+	std::vector<uint8_t> footer;
+	putBigEndian(footer, crc);
+	mFile.write((const char*)footer.data(), footer.size());
+}
+
+bool PngWriter::Open(const std::string& path, int width, int height)
+{
+	initCrcTable();
+	mFile.open(path, std::ios::binary);
+	if (!mFile)
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+	mRowsWritten = 0;
+	mAdlerA = 1;
+	mAdlerB = 0;
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	mFile.write((const char*)signature, 8);
+
+	std::vector<uint8_t> header;
+	putBigEndian(header, (uint32_t)width);
+	putBigEndian(header, (uint32_t)height);
+	header.push_back(8);	//Bit depth
+	header.push_back(6);	//RGBA
+	header.push_back(0);	//Deflate
+	header.push_back(0);	//Adaptive filtering, every row uses filter 0
+	header.push_back(0);	//No interlacing
+	writeChunk("IHDR", header.data(), header.size());
+	return (bool)mFile;
+}
+
+bool PngWriter::WriteRows(const uint8_t* rgba, int rowCount)
+{
+	rowCount = std::min(rowCount, mHeight - mRowsWritten);
+	if (rowCount <= 0)
+		return false;
+
+	//Filter byte plus pixels per row, the zlib header goes in front of the first batch
+	size_t rowSize = (size_t)mWidth * 4 + 1;
+	std::vector<uint8_t> raw;
+	raw.reserve(rowSize * rowCount);
+	for (int y = 0; y < rowCount; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + (size_t)y * mWidth * 4, rgba + (size_t)(y + 1) * mWidth * 4);
+	}
+
+	for (uint8_t byte : raw)
+	{
+		mAdlerA = (mAdlerA + byte) % 65521;
+		mAdlerB = (mAdlerB + mAdlerA) % 65521;
+	}
+
+	std::vector<uint8_t> data;
+	if (mRowsWritten == 0)
+	{
+		data.push_back(0x78);
+		data.push_back(0x01);
+	}
+
+	mRowsWritten += rowCount;
+	bool lastBatch = mRowsWritten == mHeight;
+	for (size_t offset = 0; offset < raw.size(); offset += 65535)
+	{
+		size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+		bool finalBlock = lastBatch && offset + blockSize == raw.size();
+		data.push_back(finalBlock ? 1 : 0);
+		data.push_back((uint8_t)(blockSize & 0xFF));
+		data.push_back((uint8_t)(blockSize >> 8));
+		data.push_back((uint8_t)(~blockSize & 0xFF));
+		data.push_back((uint8_t)((~blockSize >> 8) & 0xFF));
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+	}
+	if (lastBatch)
+		putBigEndian(data, (mAdlerB << 16) | mAdlerA);
+
+	writeChunk("IDAT", data.data(), data.size());
+	return (bool)mFile;
+}
+
+bool PngWriter::Close()
+{
+	if (!mFile.is_open())
+		return false;
+	bool complete = mRowsWritten == mHeight;
+	writeChunk("IEND", nullptr, 0);
+	mFile.close();
+	return complete && !mFile.fail();
+}
+
+bool writePNG(const std::string& path, int width, int height, const uint8_t* rgba)
+{
+	PngWriter writer;
+	if (!writer.Open(path, width, height))
+		return false;
+
+	//Flipped in bands, so a single band of memory is needed on top of the image
+	const int bandHeight = 64;
+	std::vector<uint8_t> band((size_t)width * 4 * std::min(bandHeight, height));
+	for (int top = height - 1; top >= 0; top -= bandHeight)
+	{
+		int rowCount = std::min(bandHeight, top + 1);
+		for (int r = 0; r < rowCount; r++)
+			memcpy(band.data() + (size_t)r * width * 4, rgba + (size_t)(top - r) * width * 4, (size_t)width * 4);
+		if (!writer.WriteRows(band.data(), rowCount))
+			return false;
+	}
+	return writer.Close();
+}
+
+bool PfmWriter::Open(const std::string& path, int width, int height)
+{
+	mFile.open(path, std::ios::binary);
+	if (!mFile)
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+	mRowsWritten = 0;
+
+	//A negative scale marks little endian floats
+	mFile << "PF\n" << width << " " << height << "\n-1.0\n";
+	return (bool)mFile;
+}
+
+bool PfmWriter::WriteRows(const glm::vec3* rgb, int rowCount)
+{
+	rowCount = std::min(rowCount, mHeight - mRowsWritten);
+	if (rowCount <= 0)
+		return false;
+
+	for (size_t i = 0; i < (size_t)mWidth * rowCount; i++)
+		mFile.write((const char*)&rgb[i].x, sizeof(float) * 3);
+	mRowsWritten += rowCount;
+	return (bool)mFile;
+}
+
+bool PfmWriter::Close()
+{
+	if (!mFile.is_open())
+		return false;
+	bool complete = mRowsWritten == mHeight;
+	mFile.close();
+	return complete && !mFile.fail();
+}
+
+bool writePFM(const std::string& path, int width, int height, const glm::vec3* rgb)
+{
+	PfmWriter writer;
+	if (!writer.Open(path, width, height) || !writer.WriteRows(rgb, height))
+		return false;
+	return writer.Close();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Core/RTWeekend.h"
+
+// PNG encoder without zlib: 8-bit RGBA, deflate with stored (uncompressed) blocks.
+// Rows can be handed over in several batches, each batch becomes one IDAT chunk.
+class PngWriter
+{
+public:
+	~PngWriter();
+
+	bool Open(const std::string& path, int width, int height);
+
+	// Appends rowCount rows of RGBA pixels, top row first as PNG wants them
+	bool WriteRows(const uint8_t* rgba, int rowCount);
+
+	// Finishes the file, false if not all rows were written
+	bool Close();
+
+private:
+	std::ofstream mFile;
+	int mWidth = 0, mHeight = 0;
+	int mRowsWritten = 0;
+	uint32_t mAdlerA = 1, mAdlerB = 0;
+
+	void writeChunk(const char* type, const uint8_t* data, size_t size);
+};
+
+// PFM writer taking the image in batches of rows, bottom row first as PFM stores them
+class PfmWriter
+{
+public:
+	bool Open(const std::string& path, int width, int height);
+
+	// Appends rowCount rows of linear RGB pixels
+	bool WriteRows(const glm::vec3* rgb, int rowCount);
+
+	// Finishes the file, false if not all rows were written
+	bool Close();
+
+private:
+	std::ofstream mFile;
+	int mWidth = 0, mHeight = 0;
+	int mRowsWritten = 0;
+};
+
+// Whole image as PNG, rows bottom up like the renderer's display buffer
+bool writePNG(const std::string& path, int width, int height, const uint8_t* rgba);
+
+// Linear float image as PFM, rows bottom up which is also the order PFM stores them in
+bool writePFM(const std::string& path, int width, int height, const glm::vec3* rgb);
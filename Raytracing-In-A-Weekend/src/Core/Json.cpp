@@ -0,0 +1,263 @@
+#include <charconv>
+#include "Core/Json.h"
+
+namespace
+{
+	const JsonValue nullValue;
+}
+
+// Recursive descent over the whole text, nesting is limited so hostile input can't exhaust the stack
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t length) : mPosition(text), mBegin(text), mEnd(text + length) {}
+
+	bool Run(JsonValue& out, std::string& error)
+	{
+		skipWhitespace();
+		bool valid = parseValue(out, 0);
+		skipWhitespace();
+		if (valid && mPosition != mEnd)
+			valid = fail("unexpected data after the document");
+		if (!valid)
+			error = mError + " at offset " + std::to_string(mPosition - mBegin);
+		return valid;
+	}
+
+private:
+	static constexpr int MaxDepth = 256;
+
+	const char* mPosition;
+	const char* mBegin;
+	const char* mEnd;
+	std::string mError;
+
+	bool fail(const char* message)
+	{
+		if (mError.empty())
+			mError = message;
+		return false;
+	}
+
+	void skipWhitespace()
+	{
+		while (mPosition < mEnd && (*mPosition == ' ' || *mPosition == '\t' || *mPosition == '\n' || *mPosition == '\r'))
+			mPosition++;
+	}
+
+	bool consume(const char* literal)
+	{
+		const char* p = mPosition;
+		for (; *literal; literal++, p++)
+		{
+			if (p >= mEnd || *p != *literal)
+				return false;
+		}
+		mPosition = p;
+		return true;
+	}
+
+	bool parseValue(JsonValue& out, int depth)
+	{
+		if (depth > MaxDepth)
+			return fail("nesting too deep");
+		if (mPosition >= mEnd)
+			return fail("unexpected end");
+
+		switch (*mPosition)
+		{
+		case '{':
+			return parseObject(out, depth);
+		case '[':
+			return parseArray(out, depth);
+		case '"':
+			out.mType = JsonValue::Type::String;
+			return parseString(out.mString);
+		case 't':
+			out.mType = JsonValue::Type::Bool;
+			out.mBool = true;
+			return consume("true") || fail("invalid literal");
+		case 'f':
+			out.mType = JsonValue::Type::Bool;
+			out.mBool = false;
+			return consume("false") || fail("invalid literal");
+		case 'n':
+			out.mType = JsonValue::Type::Null;
+			return consume("null") || fail("invalid literal");
+		default:
+			return parseNumber(out);
+		}
+	}
+
+	bool parseNumber(JsonValue& out)
+	{
+		//from_chars doesn't take a leading plus, and JSON doesn't allow one either
+		std::from_chars_result result = std::from_chars(mPosition, mEnd, out.mNumber);
+		if (result.ec != std::errc() || result.ptr == mPosition)
+			return fail("invalid number");
+		out.mType = JsonValue::Type::Number;
+		mPosition = result.ptr;
+		return true;
+	}
+
+	static void appendUtf8(std::string& out, unsigned int codePoint)
+	{
+		if (codePoint < 0x80)
+			out += (char)codePoint;
+		else if (codePoint < 0x800)
+		{
+			out += (char)(0xC0 | (codePoint >> 6));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			out += (char)(0xE0 | (codePoint >> 12));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (codePoint >> 18));
+			out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	bool parseHex4(unsigned int& value)
+	{
+		if (mEnd - mPosition < 4)
+			return fail("truncated escape");
+		std::from_chars_result result = std::from_chars(mPosition, mPosition + 4, value, 16);
+		if (result.ec != std::errc() || result.ptr != mPosition + 4)
+			return fail("invalid escape");
+		mPosition += 4;
+		return true;
+	}
+
+	bool parseString(std::string& out)
+	{
+		mPosition++; //Opening quote
+		while (true)
+		{
+			if (mPosition >= mEnd)
+				return fail("unterminated string");
+			char c = *mPosition++;
+			if (c == '"')
+				return true;
+			if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+			if (mPosition >= mEnd)
+				return fail("unterminated string");
+			char escape = *mPosition++;
+			switch (escape)
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				unsigned int codePoint;
+				if (!parseHex4(codePoint))
+					return false;
+				//Characters outside the basic plane come as a surrogate pair
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && consume("\\u"))
+				{
+					unsigned int low;
+					if (!parseHex4(low))
+						return false;
+					if (low >= 0xDC00 && low < 0xE000)
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, codePoint);
+				break;
+			}
+			default:
+				return fail("invalid escape");
+			}
+		}
+	}
+
+	bool parseArray(JsonValue& out, int depth)
+	{
+		out.mType = JsonValue::Type::Array;
+		mPosition++;
+		skipWhitespace();
+		if (consume("]"))
+			return true;
+		while (true)
+		{
+			out.mArray.emplace_back();
+			skipWhitespace();
+			if (!parseValue(out.mArray.back(), depth + 1))
+				return false;
+			skipWhitespace();
+			if (consume("]"))
+				return true;
+			if (!consume(","))
+				return fail("expected , or ]");
+		}
+	}
+
+	bool parseObject(JsonValue& out, int depth)
+	{
+		out.mType = JsonValue::Type::Object;
+		mPosition++;
+		skipWhitespace();
+		if (consume("}"))
+			return true;
+		while (true)
+		{
+			skipWhitespace();
+			if (mPosition >= mEnd || *mPosition != '"')
+				return fail("expected a key");
+			out.mObject.emplace_back();
+			if (!parseString(out.mObject.back().first))
+				return false;
+			skipWhitespace();
+			if (!consume(":"))
+				return fail("expected :");
+			skipWhitespace();
+			if (!parseValue(out.mObject.back().second, depth + 1))
+				return false;
+			skipWhitespace();
+			if (consume("}"))
+				return true;
+			if (!consume(","))
+				return fail("expected , or }");
+		}
+	}
+};
+
+bool JsonValue::Parse(const char* text, size_t length, JsonValue& out, std::string& error)
+{
+	out = JsonValue();
+	return JsonParser(text, length).Run(out, error);
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (mType != Type::Array || index >= mArray.size())
+		return nullValue;
+	return mArray[index];
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	if (mType != Type::Object)
+		return nullValue;
+	for (const std::pair<std::string, JsonValue>& member : mObject)
+	{
+		if (member.first == key)
+			return member.second;
+	}
+	return nullValue;
+}
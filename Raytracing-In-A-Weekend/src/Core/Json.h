@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small read only JSON document, enough for scene and model descriptions.
+// Looking up a missing key or index gives a null value, so optional fields need no checks.
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	// False with a message naming the byte offset if the text is not valid JSON
+	static bool Parse(const char* text, size_t length, JsonValue& out, std::string& error);
+
+	Type GetType() const { return mType; }
+	bool IsNull() const { return mType == Type::Null; }
+	bool IsNumber() const { return mType == Type::Number; }
+	bool IsString() const { return mType == Type::String; }
+	bool IsArray() const { return mType == Type::Array; }
+	bool IsObject() const { return mType == Type::Object; }
+
+	bool AsBool(bool fallback = false) const { return mType == Type::Bool ? mBool : fallback; }
+	double AsNumber(double fallback = 0.0) const { return mType == Type::Number ? mNumber : fallback; }
+	const std::string& AsString() const { return mString; }
+
+	// Elements of an array or members of an object, 0 otherwise
+	size_t Size() const { return mType == Type::Array ? mArray.size() : mType == Type::Object ? mObject.size() : 0; }
+	const JsonValue& operator[](size_t index) const;
+	const JsonValue& operator[](const std::string& key) const;
+	bool Has(const std::string& key) const { return !(*this)[key].IsNull(); }
+	const std::vector<std::pair<std::string, JsonValue>>& Members() const { return mObject; }
+
+private:
+	Type mType = Type::Null;
+	bool mBool = false;
+	double mNumber = 0.0;
+	std::string mString;
+	std::vector<JsonValue> mArray;
+	std::vector<std::pair<std::string, JsonValue>> mObject;
+
+	friend class JsonParser;
+};
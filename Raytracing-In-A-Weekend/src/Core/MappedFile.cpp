@@ -0,0 +1,53 @@
+#include "Core/MappedFile.h"
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path)
+{
+	std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream)
+		return nullptr;
+	std::streamoff size = stream.tellg();
+	if (size <= 0)
+		return nullptr;
+	file->mBuffer.resize((size_t)size);
+	stream.seekg(0);
+	if (!stream.read(reinterpret_cast<char*>(file->mBuffer.data()), size))
+		return nullptr;
+	file->mData = file->mBuffer.data();
+	file->mSize = file->mBuffer.size();
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //The mapping keeps its own reference
+	if (data == MAP_FAILED)
+		return nullptr;
+	file->mData = static_cast<const uint8_t*>(data);
+	file->mSize = (size_t)info.st_size;
+#endif
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (mData)
+		munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+}
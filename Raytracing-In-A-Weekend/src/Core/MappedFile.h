@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. On POSIX the file is memory mapped, so its pages are only read when touched and
+// are shared with the page cache; elsewhere it is read into memory once.
+class MappedFile
+{
+public:
+	// nullptr if the file can't be opened or is empty
+	static std::shared_ptr<MappedFile> Open(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* Data() const { return mData; }
+	size_t Size() const { return mSize; }
+
+private:
+	MappedFile() = default;
+
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+	std::vector<uint8_t> mBuffer; //Only used without mmap
+};
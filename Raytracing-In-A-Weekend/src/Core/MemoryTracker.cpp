@@ -0,0 +1,96 @@
+#include "Core/MemoryTracker.h"
+
+MemoryTracker& MemoryTracker::Get()
+{
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+void MemoryTracker::add(Counter& counter, size_t bytes)
+{
+	size_t current = counter.current.fetch_add(bytes) + bytes;
+	size_t peak = counter.peak.load();
+	while (current > peak && !counter.peak.compare_exchange_weak(peak, current))
+	{
+	}
+}
+
+void MemoryTracker::Add(MemoryCategory category, size_t bytes)
+{
+	if (bytes == 0)
+		return;
+	add(mCounters[(int)category], bytes);
+	add(mTotal, bytes);
+}
+
+void MemoryTracker::Remove(MemoryCategory category, size_t bytes)
+{
+	mCounters[(int)category].current -= bytes;
+	mTotal.current -= bytes;
+}
+
+MemoryUsage MemoryTracker::Usage(MemoryCategory category) const
+{
+	const Counter& counter = mCounters[(int)category];
+	return { counter.current.load(), counter.peak.load() };
+}
+
+MemoryUsage MemoryTracker::Total() const
+{
+	return { mTotal.current.load(), mTotal.peak.load() };
+}
+
+void MemoryTracker::ResetPeaks()
+{
+	for (Counter& counter : mCounters)
+		counter.peak = counter.current.load();
+	mTotal.peak = mTotal.current.load();
+}
+
+const char* MemoryTracker::Name(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Triangles: return "triangles";
+	case MemoryCategory::BvhNodes: return "bvh_nodes";
+	case MemoryCategory::Textures: return "textures";
+	case MemoryCategory::Framebuffers: return "framebuffers";
+	case MemoryCategory::ImportTemporaries: return "import_temporaries";
+	case MemoryCategory::SceneObjects: return "scene_objects";
+	default: return "unknown";
+	}
+}
+
+TrackedMemory::TrackedMemory(MemoryCategory category, size_t bytes)
+	: mCategory(category), mBytes(bytes)
+{
+	MemoryTracker::Get().Add(mCategory, mBytes);
+}
+
+TrackedMemory::TrackedMemory(const TrackedMemory& other)
+	: TrackedMemory(other.mCategory, other.mBytes)
+{
+}
+
+TrackedMemory& TrackedMemory::operator=(const TrackedMemory& other)
+{
+	MemoryTracker::Get().Remove(mCategory, mBytes);
+	mCategory = other.mCategory;
+	mBytes = other.mBytes;
+	MemoryTracker::Get().Add(mCategory, mBytes);
+	return *this;
+}
+
+TrackedMemory::~TrackedMemory()
+{
+	MemoryTracker::Get().Remove(mCategory, mBytes);
+}
+
+void TrackedMemory::Set(size_t bytes)
+{
+	if (bytes > mBytes)
+		MemoryTracker::Get().Add(mCategory, bytes - mBytes);
+	else
+		MemoryTracker::Get().Remove(mCategory, mBytes - bytes);
+	mBytes = bytes;
+}
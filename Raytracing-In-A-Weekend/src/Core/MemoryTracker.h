@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// What the tracked bytes are used for. SceneObjects is everything else living in a SceneArena.
+enum class MemoryCategory
+{
+	Triangles,         //Mesh vertices, indices and material indices, and loose Triangle objects
+	BvhNodes,          //Mesh BVHs and the scene's top level tree
+	Textures,          //Decoded texels and resident pages of streamed textures
+	Framebuffers,      //Display buffers and radiance sums of the raytracers
+	ImportTemporaries, //Importer scenes, decoder output and BVH build buffers, only alive while loading
+	SceneObjects,
+	Count
+};
+
+struct MemoryUsage
+{
+	size_t currentBytes = 0;
+	size_t peakBytes = 0;
+};
+
+// Process wide byte counters per subsystem, kept by the code that owns the memory rather than by hooking
+// the allocator. Peaks are per category, the total has its own peak of the sum.
+class MemoryTracker
+{
+public:
+	static MemoryTracker& Get();
+
+	void Add(MemoryCategory category, size_t bytes);
+	void Remove(MemoryCategory category, size_t bytes);
+
+	MemoryUsage Usage(MemoryCategory category) const;
+	MemoryUsage Total() const;
+	// Restarts every peak at the current value, e.g. before loading the next scene
+	void ResetPeaks();
+
+	// Lower case identifier, used as the JSON key
+	static const char* Name(MemoryCategory category);
+
+private:
+	struct Counter
+	{
+		std::atomic<size_t> current{ 0 };
+		std::atomic<size_t> peak{ 0 };
+	};
+
+	Counter mCounters[(int)MemoryCategory::Count];
+	Counter mTotal;
+
+	MemoryTracker() = default;
+	static void add(Counter& counter, size_t bytes);
+};
+
+// Bytes held by one object, counted in its category while the object lives. Copies count their bytes again.
+class TrackedMemory
+{
+public:
+	explicit TrackedMemory(MemoryCategory category, size_t bytes = 0);
+	TrackedMemory(const TrackedMemory& other);
+	TrackedMemory& operator=(const TrackedMemory& other);
+	~TrackedMemory();
+
+	void Set(size_t bytes);
+	size_t Bytes() const { return mBytes; }
+
+private:
+	MemoryCategory mCategory;
+	size_t mBytes;
+};
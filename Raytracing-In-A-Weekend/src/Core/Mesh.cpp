@@ -1,210 +1,502 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include "Core/Mesh.h"
+#include "Core/GltfLoader.h"
 #include "Material/Texture.h"
+#include "Material/TextureCache.h"
 #include "Material/Material.h"
-#include "AccelerationStructures/Bvh.h"
 
-Mesh::Mesh(glm::mat4 model, std::string const& location)
-    : modelMatrix(model), matPtr(nullptr), directory(location.substr(0, location.find_last_of('/')))
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point from, Clock::time_point to)
 {
-    Assimp::Importer importer;
+    return std::chrono::duration<double>(to - from).count();
+}
+
+namespace
+{
+    // Vertex access of the two formats. The traversal only reads positions, the rest is decoded for the closest triangle.
+    struct FullVertices
+    {
+        const Vertex* vertices;
 
-    const aiScene* scene = importer.ReadFile(location, aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals);
+        const glm::vec3& Position(uint32_t index) const { return vertices[index].position; }
+        const Vertex& Decode(uint32_t index) const { return vertices[index]; }
+    };
 
-    if (scene)
+    struct CompactVertices
     {
-        float xMin = infinity;
-        float yMin = infinity;
-        float zMin = infinity;
-        float xMax = 1e-8;
-        float yMax = 1e-8;
-        float zMax = 1e-8;
+        const PackedVertex* vertices;
+        VertexQuantization quantization;
 
-        processNode(scene->mRootNode, scene, xMin, yMin, zMin, xMax, yMax, zMax);
+        glm::vec3 Position(uint32_t index) const { return vertices[index].Position(quantization); }
+        Vertex Decode(uint32_t index) const { return vertices[index].Unpack(quantization); }
+    };
+}
 
-        glm::vec3 minimum = glm::vec3(xMin, yMin, zMin);
-        glm::vec3 maximum = glm::vec3(xMax, yMax, zMax);
-        boundingBox = std::make_shared<AABB>(minimum, maximum);
+Mesh::Mesh(glm::mat4 model, std::string const& location)
+    : modelMatrix(model), directory(location.substr(0, location.find_last_of('/')))
+{
+    auto loadStart = Clock::now();
+    MeshVertexFormat format = vertexFormat;
+    uint64_t key = MeshCache::Key(modelMatrix, ImportFlags, format);
+    uint64_t sourceStamp = MeshCache::SourceStamp(location);
+    std::string cachePath = MeshCache::CachePath(location, format);
 
-        std::shared_ptr<BVHNode> bvh = std::make_shared<BVHNode>(triangles, 0, triangles.size(), 10);
-        triangles.clear();
-        triangles.push_back(bvh);
+    std::vector<MeshMaterialDesc> descs;
+    cacheFile = MeshCache::Open(cachePath, key, sourceStamp, geometry, descs);
+    if (cacheFile)
+    {
+        loadTimings.fromCache = true;
+        loadTimings.parseSeconds = seconds(loadStart, Clock::now());
+        for (const MeshMaterialDesc& desc : descs)
+            materials.push_back(createMaterial(desc));
+    }
+    else if (import(location, format, descs))
+    {
+        if (!MeshCache::Write(cachePath, key, sourceStamp, geometry, descs))
+            std::cerr << "Could not write mesh cache " << cachePath << std::endl;
     }
     else
     {
         std::cout << "Could not import model at location: " << location << std::endl;
+        return;
+    }
+
+    auto texturesStart = Clock::now();
+    for (const PendingTexture& pending : pendingTextures)
+    {
+        std::shared_ptr<Texture> texture = pending.texture.get();
+        if (!texture || !texture->Valid())
+            continue;
+        if (pending.slot == MeshTextureSlot::Diffuse)
+            pending.material->setDiffuseTexture(texture);
+        else if (pending.slot == MeshTextureSlot::Roughness)
+            pending.material->setRoughnessTexture(texture);
+        else if (pending.slot == MeshTextureSlot::Normal)
+            pending.material->setNormalTexture(texture);
+        else if (pending.slot == MeshTextureSlot::Emissive)
+            pending.material->setEmissiveTexture(texture);
     }
+    pendingTextures.clear();
+    if (loadTimings.fromCache)
+        loadTimings.textureSeconds = seconds(texturesStart, Clock::now());
+    else
+        loadTimings.textureSeconds = seconds(loadStart, Clock::now()) - loadTimings.parseSeconds;
+
+    //Counted the same whether the arrays are owned or mapped from the cache, mapped pages take memory once touched
+    triangleMemory.Set(geometry.vertexCount * MeshCache::VertexBytes(geometry.vertexFormat) + geometry.triangleCount * 4 * sizeof(uint32_t));
+    nodeMemory.Set(geometry.nodeCount * sizeof(MeshBVHNode));
+
+    if (geometry.nodeCount > 0)
+        boundingBox = std::make_shared<AABB>(geometry.nodes[0].minimum, geometry.nodes[0].maximum);
+    else
+        boundingBox = std::make_shared<AABB>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+
+    std::cerr << "Loaded " << location << " (" << geometry.triangleCount << " triangles" << (loadTimings.fromCache ? ", cached" : "") << "): parse "
+        << loadTimings.parseSeconds * 1000.0 << " ms, triangles " << loadTimings.triangleSeconds * 1000.0 << " ms, textures "
+        << loadTimings.textureSeconds * 1000.0 << " ms, BVH " << loadTimings.bvhSeconds * 1000.0 << " ms" << std::endl;
 }
 
-void Mesh::processNode(aiNode* node, const aiScene* scene, float& xMin, float& yMin, float& zMin, float& xMax, float& yMax, float& zMax)
+bool Mesh::Hit(const Ray& r, float tMin, float tMax, HitRecord& rec) const
 {
-    
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    if (geometry.nodeCount == 0)
+        return false;
+    if (geometry.packedVertices)
+        return hitGeometry(CompactVertices{ geometry.packedVertices, geometry.quantization }, r, tMin, tMax, rec);
+    return hitGeometry(FullVertices{ geometry.vertices }, r, tMin, tMax, rec);
+}
+
+template<typename Vertices>
+bool Mesh::hitGeometry(const Vertices& vertices, const Ray& r, float tMin, float tMax, HitRecord& rec) const
+{
+    glm::vec3 inverseDirection = 1.0f / r.direction;
+    bool directionNegative[3] = { r.direction.x < 0.0f, r.direction.y < 0.0f, r.direction.z < 0.0f };
+    if (MeshBVH::Intersect(geometry.nodes[0], r.origin, inverseDirection, tMin, tMax) == infinity)
+        return false;
+
+    //Nodes still to visit with their entry distance, skipped once a closer hit was found
+    struct StackEntry
+    {
+        uint32_t node;
+        float entry;
+    };
+    StackEntry stack[MeshBVH::MaxDepth];
+    int stackSize = 0;
+
+    uint32_t nodeIndex = 0;
+    float closestSoFar = tMax;
+    size_t hitTriangle = geometry.triangleCount;
+    float hitU = 0.0f;
+    float hitV = 0.0f;
+    while (true)
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        processMesh(mesh, scene, xMin, yMin, zMin, xMax, yMax, zMax);
+        const MeshBVHNode& node = geometry.nodes[nodeIndex];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const uint32_t* triangle = geometry.indices + 3 * (size_t)i;
+                float t, u, v;
+                if (intersectTriangle(vertices.Position(triangle[0]), vertices.Position(triangle[1]), vertices.Position(triangle[2]), r, tMin, closestSoFar, t, u, v))
+                {
+                    closestSoFar = t;
+                    hitTriangle = i;
+                    hitU = u;
+                    hitV = v;
+                }
+            }
+        }
+        else
+        {
+            //The first child holds the lower half along the split axis, it is the near one unless the ray points down that axis
+            uint32_t nearChild = nodeIndex + 1;
+            uint32_t farChild = node.offset;
+            if (directionNegative[node.axis])
+                std::swap(nearChild, farChild);
+            float nearEntry = MeshBVH::Intersect(geometry.nodes[nearChild], r.origin, inverseDirection, tMin, closestSoFar);
+            float farEntry = MeshBVH::Intersect(geometry.nodes[farChild], r.origin, inverseDirection, tMin, closestSoFar);
+            if (nearEntry != infinity)
+            {
+                if (farEntry != infinity)
+                    stack[stackSize++] = { farChild, farEntry };
+                nodeIndex = nearChild;
+                continue;
+            }
+            if (farEntry != infinity)
+            {
+                nodeIndex = farChild;
+                continue;
+            }
+        }
+
+        while (stackSize > 0 && stack[stackSize - 1].entry > closestSoFar)
+            stackSize--;
+        if (stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize].node;
     }
-    // then do the same for each of its children
-    for (unsigned int i = 0; i < node->mNumChildren; i++)
+
+    if (hitTriangle == geometry.triangleCount)
+        return false;
+
+    //Only the closest triangle's surface is interpolated
+    const uint32_t* triangle = geometry.indices + 3 * hitTriangle;
+    const Vertex& vert0 = vertices.Decode(triangle[0]);
+    const Vertex& vert1 = vertices.Decode(triangle[1]);
+    const Vertex& vert2 = vertices.Decode(triangle[2]);
+    float uvScale = (r.coneSpread > 0.0f || r.coneWidth > 0.0f) ? triangleUvScale(vert0, vert1, vert2) : 0.0f;
+    triangleHitRecord(vert0, vert1, vert2, uvScale, r, closestSoFar, hitU, hitV, rec);
+    rec.modelMatrix = modelMatrix;
+    rec.matPtr = materials[geometry.materialIndices[hitTriangle]];
+    rec.lightIndex = lightIndices.empty() ? -1 : lightIndices[hitTriangle];
+    return true;
+}
+
+void Mesh::CollectEmitters(std::vector<LightTriangle>& lights)
+{
+    lightIndices.clear();
+    if (std::none_of(materials.begin(), materials.end(), [](const std::shared_ptr<Material>& material) { return material->isEmissive(); }))
+        return;
+
+    lightIndices.assign(geometry.triangleCount, -1);
+    for (size_t i = 0; i < geometry.triangleCount; i++)
     {
-        processNode(node->mChildren[i], scene, xMin, yMin, zMin, xMax, yMax, zMax);
+        const uint32_t* triangle = geometry.indices + 3 * i;
+        LightTriangle light;
+        if (!buildLightTriangle(geometry.VertexAt(triangle[0]), geometry.VertexAt(triangle[1]), geometry.VertexAt(triangle[2]), materials[geometry.materialIndices[i]], light))
+            continue;
+        lightIndices[i] = (int)lights.size();
+        lights.push_back(light);
     }
 }
 
-void Mesh::processMesh(aiMesh* mesh, const aiScene* scene, float& xMin, float& yMin, float& zMin, float& xMax, float& yMax, float& zMax)
+bool Mesh::import(const std::string& location, MeshVertexFormat format, std::vector<MeshMaterialDesc>& descs)
 {
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    std::shared_ptr<Texture> diffuseTexture = nullptr;
-    if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+    auto parseStart = Clock::now();
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> materialIndices;
+    bool imported = false;
+
+    //glTF is read directly, assimp is only needed for other formats and glTF features the loader doesn't cover
+    if (GltfModel::Handles(location))
     {
-        aiString str;
-        material->GetTexture(aiTextureType_DIFFUSE, 0, &str);
+        std::string error;
+        std::unique_ptr<GltfModel> gltf = GltfModel::Open(location, error);
+        if (gltf)
+        {
+            loadTimings.parseSeconds = seconds(parseStart, Clock::now());
+            descs = gltf->Materials();
+            for (const MeshMaterialDesc& desc : descs)
+                materials.push_back(createMaterial(desc));
+            gltf->LoadGeometry(modelMatrix, vertexStorage, indices, materialIndices);
+            imported = true;
+        }
+        else
+            std::cerr << "Importing " << location << " with assimp: " << error << std::endl;
+    }
+    if (!imported && !importAssimp(location, descs, indices, materialIndices))
+        return false;
+    auto trianglesEnd = Clock::now();
+    loadTimings.triangleSeconds = seconds(parseStart, trianglesEnd) - loadTimings.parseSeconds;
 
-        std::string filename = directory + '/' + str.C_Str();
-        if(std::find(loadedTextures.begin(), loadedTextures.end(), filename) == loadedTextures.end())
+    //Packed vertices replace the full ones before the BVH is built, so its bounds hold the quantized positions
+    geometry.vertexFormat = format;
+    if (format == MeshVertexFormat::Compact)
+    {
+        geometry.quantization = VertexQuantization::FromVertices(vertexStorage);
+        packedVertexStorage.resize(vertexStorage.size());
+        for (size_t v = 0; v < vertexStorage.size(); v++)
         {
-            loadedTextures.push_back(filename);
-            diffuseTexture = std::make_shared<Texture>(filename.c_str());
+            packedVertexStorage[v] = PackedVertex::Pack(vertexStorage[v], geometry.quantization);
+            vertexStorage[v].position = packedVertexStorage[v].Position(geometry.quantization);
         }
+    }
 
-        if(!matPtr)
-            matPtr = std::make_shared<PBRMaterial>(diffuseTexture);
+    //Triangles are stored in leaf order, so every leaf is a contiguous range
+    size_t triangleCount = materialIndices.size();
+    std::vector<glm::vec3> minimums(triangleCount);
+    std::vector<glm::vec3> maximums(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = vertexStorage[indices[3 * t]].position;
+        const glm::vec3& p1 = vertexStorage[indices[3 * t + 1]].position;
+        const glm::vec3& p2 = vertexStorage[indices[3 * t + 2]].position;
+        minimums[t] = glm::min(p0, glm::min(p1, p2));
+        maximums[t] = glm::max(p0, glm::max(p1, p2));
     }
-    if (material->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS) > 0 && matPtr)
+    //Everything built so far is a temporary until the final arrays are counted by the constructor
+    TrackedMemory buildMemory(MemoryCategory::ImportTemporaries, vertexStorage.capacity() * sizeof(Vertex) + packedVertexStorage.capacity() * sizeof(PackedVertex)
+        + (indices.capacity() + materialIndices.capacity() + triangleCount) * sizeof(uint32_t) + 2 * triangleCount * sizeof(glm::vec3));
+    std::vector<uint32_t> order;
+    nodeStorage = MeshBVH::Build(minimums, maximums, order);
+    indexStorage.resize(3 * triangleCount);
+    materialIndexStorage.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++)
     {
-        std::shared_ptr<Texture> roughnessTexture = nullptr;
-        aiString str;
-        material->GetTexture(aiTextureType_DIFFUSE_ROUGHNESS, 0, &str);
+        for (int k = 0; k < 3; k++)
+            indexStorage[3 * i + k] = indices[3 * (size_t)order[i] + k];
+        materialIndexStorage[i] = materialIndices[order[i]];
+    }
+    loadTimings.bvhSeconds = seconds(trianglesEnd, Clock::now());
+
+    geometry.vertexCount = vertexStorage.size();
+    if (format == MeshVertexFormat::Compact)
+    {
+        std::vector<Vertex>().swap(vertexStorage);
+        geometry.packedVertices = packedVertexStorage.data();
+    }
+    else
+        geometry.vertices = vertexStorage.data();
+    geometry.indices = indexStorage.data();
+    geometry.materialIndices = materialIndexStorage.data();
+    geometry.nodes = nodeStorage.data();
+    geometry.triangleCount = triangleCount;
+    geometry.nodeCount = nodeStorage.size();
+    return true;
+}
+
+bool Mesh::importAssimp(const std::string& location, std::vector<MeshMaterialDesc>& descs, std::vector<uint32_t>& indices, std::vector<uint32_t>& materialIndices)
+{
+    auto parseStart = Clock::now();
+    Assimp::Importer importer;
+
+    const aiScene* scene = importer.ReadFile(location, ImportFlags);
+    auto parseEnd = Clock::now();
+    loadTimings.parseSeconds = seconds(parseStart, parseEnd);
+    if (!scene)
+        return false;
+
+    //The importer's scene lives until the end of this function
+    aiMemoryInfo importerMemory;
+    importer.GetMemoryRequirements(importerMemory);
+    TrackedMemory sceneMemory(MemoryCategory::ImportTemporaries, importerMemory.total);
+
+    std::vector<aiMesh*> meshes;
+    processNode(scene->mRootNode, scene, meshes);
 
-        std::string filename = directory + '/' + str.C_Str();
-        if (std::find(loadedTextures.begin(), loadedTextures.end(), filename) == loadedTextures.end())
+    //Materials first, their texture decodes run on their own threads while the triangles are converted.
+    //Only the materials in use are kept, numbered in order of first use.
+    std::vector<int> materialSlots(scene->mNumMaterials, -1);
+    for (aiMesh* mesh : meshes)
+    {
+        if (materialSlots[mesh->mMaterialIndex] >= 0)
+            continue;
+        materialSlots[mesh->mMaterialIndex] = (int)descs.size();
+        descs.push_back(describeMaterial(scene->mMaterials[mesh->mMaterialIndex]));
+        materials.push_back(createMaterial(descs.back()));
+    }
+
+    //Every mesh gets its own range of the presized vertex buffer, split into chunks so big meshes are shared out too
+    const unsigned int chunkVertices = 16384;
+    struct Chunk
+    {
+        aiMesh* mesh;
+        unsigned int firstVertex, lastVertex;
+        size_t offset;
+    };
+    std::vector<Chunk> chunks;
+    std::vector<size_t> baseVertices;
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    for (aiMesh* mesh : meshes)
+    {
+        for (unsigned int v = 0; v < mesh->mNumVertices; v += chunkVertices)
+            chunks.push_back({ mesh, v, std::min(v + chunkVertices, mesh->mNumVertices), vertexCount + v });
+        baseVertices.push_back(vertexCount);
+        vertexCount += mesh->mNumVertices;
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
         {
-            loadedTextures.push_back(filename);
-            roughnessTexture = std::make_shared<Texture>(filename.c_str());
+            if (mesh->mFaces[f].mNumIndices == 3)
+                triangleCount++;
         }
-
-        if(roughnessTexture)
-            std::static_pointer_cast<PBRMaterial, Material>(matPtr)->setRoughnessTexture(roughnessTexture);
     }
-    if (material->GetTextureCount(aiTextureType_NORMALS) > 0 && matPtr)
+    vertexStorage.resize(vertexCount);
+
+    int workerCount = (int)std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned int)chunks.size()));
+    std::atomic<size_t> nextChunk(0);
+    std::vector<std::future<void>> workers;
+    for (int w = 0; w < workerCount; w++)
     {
-        std::shared_ptr<Texture> normalTexture = nullptr;
-        aiString str;
-        material->GetTexture(aiTextureType_NORMALS, 0, &str);
+        workers.push_back(std::async(std::launch::async, [this, &chunks, &nextChunk]
+            {
+                for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++)
+                    processVertices(chunks[c].mesh, chunks[c].firstVertex, chunks[c].lastVertex, vertexStorage.data() + chunks[c].offset);
+            }));
+    }
+    for (std::future<void>& worker : workers)
+        worker.get();
 
-        std::string filename = directory + '/' + str.C_Str();
-        if (std::find(loadedTextures.begin(), loadedTextures.end(), filename) == loadedTextures.end())
+    //Indices become global, points and lines left over by triangulation are dropped
+    indices.resize(3 * triangleCount);
+    materialIndices.resize(triangleCount);
+    size_t triangle = 0;
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        aiMesh* mesh = meshes[m];
+        uint32_t materialIndex = (uint32_t)materialSlots[mesh->mMaterialIndex];
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++)
         {
-            loadedTextures.push_back(filename);
-            normalTexture = std::make_shared<Texture>(filename.c_str());
+            const aiFace& face = mesh->mFaces[f];
+            if (face.mNumIndices != 3)
+                continue;
+            for (int k = 0; k < 3; k++)
+                indices[3 * triangle + k] = (uint32_t)(baseVertices[m] + face.mIndices[k]);
+            materialIndices[triangle] = materialIndex;
+            triangle++;
         }
+    }
+    return true;
+}
+
+void Mesh::processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes)
+{
 
-        if (normalTexture)
-            std::static_pointer_cast<PBRMaterial, Material>(matPtr)->setNormalTexture(normalTexture);
-    }
-
-    for (unsigned int f = 0; f < mesh->mNumFaces; f++)
-    {
-        aiFace face = mesh->mFaces[f];
-        unsigned int v0 = face.mIndices[0];
-        unsigned int v1 = face.mIndices[1];
-        unsigned int v2 = face.mIndices[2];
-        glm::vec3 pos0(mesh->mVertices[v0].x, mesh->mVertices[v0].y, mesh->mVertices[v0].z);
-        glm::vec3 pos1(mesh->mVertices[v1].x, mesh->mVertices[v1].y, mesh->mVertices[v1].z);
-        glm::vec3 pos2(mesh->mVertices[v2].x, mesh->mVertices[v2].y, mesh->mVertices[v2].z);
-        glm::vec3 tangent0(mesh->mTangents[v0].x, mesh->mTangents[v0].y, mesh->mTangents[v0].z);
-        glm::vec3 tangent1(mesh->mTangents[v1].x, mesh->mTangents[v1].y, mesh->mTangents[v1].z);
-        glm::vec3 tangent2(mesh->mTangents[v2].x, mesh->mTangents[v2].y, mesh->mTangents[v2].z);
-        glm::vec3 bitangent0(mesh->mBitangents[v0].x, mesh->mBitangents[v0].y, mesh->mBitangents[v0].z);
-        glm::vec3 bitangent1(mesh->mBitangents[v1].x, mesh->mBitangents[v1].y, mesh->mBitangents[v1].z);
-        glm::vec3 bitangent2(mesh->mBitangents[v2].x, mesh->mBitangents[v2].y, mesh->mBitangents[v2].z);
-
-        glm::vec3 tex0(0.0f, 0.0f, 0.0f);
-        glm::vec3 tex1(0.1f, 0.0f, 0.0f);
-        glm::vec3 tex2(0.5f, 1.0f, 0.0f);
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    }
+    // then do the same for each of its children
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        processNode(node->mChildren[i], scene, meshes);
+    }
+}
+
+void Mesh::processVertices(aiMesh* mesh, unsigned int firstVertex, unsigned int lastVertex, Vertex* out) const
+{
+    glm::mat3 directionMatrix(modelMatrix);
+    glm::mat3 normalMatrix(glm::transpose(glm::inverse(modelMatrix)));
+
+    for (unsigned int v = firstVertex; v < lastVertex; v++)
+    {
+        Vertex& vertex = out[v - firstVertex];
+        glm::vec3 position(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+        vertex.position = glm::vec3(modelMatrix * glm::vec4(position, 1.0f));
+
+        //Without uvs the hit falls back to the barycentric coordinates, without tangents to a constant frame
+        vertex.textureCoord = glm::vec3(-1.0f, 0.0f, 0.0f);
         if (mesh->mTextureCoords[0])
-        {
-            tex0.x = mesh->mTextureCoords[0][v0].x;
-            tex0.y = mesh->mTextureCoords[0][v0].y;
-            tex1.x = mesh->mTextureCoords[0][v1].x;
-            tex1.y = mesh->mTextureCoords[0][v1].y;
-            tex2.x = mesh->mTextureCoords[0][v2].x;
-            tex2.y = mesh->mTextureCoords[0][v2].y;
-        }
-        glm::vec3 norm0(0.0f, 0.0f, 0.0f);
-        glm::vec3 norm1(0.0f, 0.0f, 0.0f);
-        glm::vec3 norm2(0.0f, 0.0f, 0.0f);
+            vertex.textureCoord = glm::vec3(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y, 0.0f);
+
+        vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
         if (mesh->HasNormals())
+            vertex.normal = normalMatrix * glm::normalize(glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z));
+
+        vertex.tangent = glm::vec3(-1.0f, 0.0f, 0.0f);
+        vertex.bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+        if (mesh->HasTangentsAndBitangents())
         {
-            norm0 = glm::normalize(glm::vec3(mesh->mNormals[v0].x, mesh->mNormals[v0].y, mesh->mNormals[v0].z));
-            norm1 = glm::normalize(glm::vec3(mesh->mNormals[v1].x, mesh->mNormals[v1].y, mesh->mNormals[v1].z));
-            norm2 = glm::normalize(glm::vec3(mesh->mNormals[v2].x, mesh->mNormals[v2].y, mesh->mNormals[v2].z));
+            glm::vec3 tangent(mesh->mTangents[v].x, mesh->mTangents[v].y, mesh->mTangents[v].z);
+            glm::vec3 bitangent(mesh->mBitangents[v].x, mesh->mBitangents[v].y, mesh->mBitangents[v].z);
+            vertex.tangent = directionMatrix * tangent;
+            vertex.bitangent = directionMatrix * bitangent;
         }
-
-        glm::mat3 normalMatrix(glm::transpose(glm::inverse(modelMatrix)));
-        pos0 = glm::vec3(modelMatrix * glm::vec4(pos0, 1.0f));
-        pos1 = glm::vec3(modelMatrix * glm::vec4(pos1, 1.0f));
-        pos2 = glm::vec3(modelMatrix * glm::vec4(pos2, 1.0f));
-        norm0 = glm::vec3(normalMatrix * glm::vec4(norm0, 1.0f));
-        norm1 = glm::vec3(normalMatrix * glm::vec4(norm1, 1.0f));
-        norm2 = glm::vec3(normalMatrix * glm::vec4(norm2, 1.0f));
-        tangent0 = glm::vec3(modelMatrix * glm::vec4(tangent0, 1.0f));
-        tangent1 = glm::vec3(modelMatrix * glm::vec4(tangent1, 1.0f));
-        tangent2 = glm::vec3(modelMatrix * glm::vec4(tangent2, 1.0f));
-        bitangent0 = glm::vec3(modelMatrix * glm::vec4(bitangent0, 1.0f));
-        bitangent1 = glm::vec3(modelMatrix * glm::vec4(bitangent1, 1.0f));
-        bitangent2 = glm::vec3(modelMatrix * glm::vec4(bitangent2, 1.0f));
-
-        Vertex vert0(pos0, norm0, tex0, tangent0, bitangent0);
-        Vertex vert1(pos1, norm1, tex1, tangent1, bitangent1);
-        Vertex vert2(pos2, norm2, tex2, tangent2, bitangent2);
-
-        auto tri = std::make_shared<Triangle>(vert0, vert1, vert2, modelMatrix, matPtr, "");
-        triangles.push_back(tri);
-
-        //MIN
-        if (pos0.x < xMin)
-            xMin = pos0.x;
-        if (pos1.x < xMin)
-            xMin = pos1.x;
-        if (pos2.x < xMin)
-            xMin = pos2.x;
-
-        if (pos0.y < yMin)
-            yMin = pos0.y;
-        if (pos1.y < yMin)
-            yMin = pos1.y;
-        if (pos2.y < yMin)
-            yMin = pos2.y;
-
-        if (pos0.z < zMin)
-            zMin = pos0.z;
-        if (pos1.z < zMin)
-            zMin = pos1.z;
-        if (pos2.z < zMin)
-            zMin = pos2.z;
-
-        //MAX
-        if (pos0.x > xMax)
-            xMax = pos0.x;
-        if (pos1.x > xMax)
-            xMax = pos1.x;
-        if (pos2.x > xMax)
-            xMax = pos2.x;
-
-        if (pos0.y > yMax)
-            yMax = pos0.y;
-        if (pos1.y > yMax)
-            yMax = pos1.y;
-        if (pos2.y > yMax)
-            yMax = pos2.y;
-
-        if (pos0.z > zMax)
-            zMax = pos0.z;
-        if (pos1.z > zMax)
-            zMax = pos1.z;
-        if (pos2.z > zMax)
-            zMax = pos2.z;
     }
+}
+
+void Mesh::requestTexture(const std::string& path, MeshTextureSlot slot, const std::shared_ptr<PBRMaterial>& matPtr)
+{
+    if (path.empty())
+        return;
 
+    std::string filename = directory + '/' + path;
+    TextureUsage usage = TextureUsage::Color;
+    if (slot == MeshTextureSlot::Normal)
+        usage = TextureUsage::Linear;
+    else if (slot == MeshTextureSlot::Roughness)
+        usage = TextureUsage::Roughness;
+
+    //Decodes on its own thread, materials and meshes sharing a file share the texture
+    pendingTextures.push_back({ matPtr, slot, TextureCache::Get().LoadAsync(filename, usage) });
+}
+
+MeshMaterialDesc Mesh::describeMaterial(aiMaterial* material) const
+{
+    MeshMaterialDesc desc;
+    auto texturePath = [material](aiTextureType type)
+    {
+        if (material->GetTextureCount(type) == 0)
+            return std::string();
+        aiString str;
+        material->GetTexture(type, 0, &str);
+        return std::string(str.C_Str());
+    };
+    desc.textures[(int)MeshTextureSlot::Diffuse] = texturePath(aiTextureType_DIFFUSE);
+    desc.textures[(int)MeshTextureSlot::Roughness] = texturePath(aiTextureType_DIFFUSE_ROUGHNESS);
+    desc.textures[(int)MeshTextureSlot::Normal] = texturePath(aiTextureType_NORMALS);
+    desc.textures[(int)MeshTextureSlot::Emissive] = texturePath(aiTextureType_EMISSIVE);
+
+    aiColor3D diffuseColor(1.0f, 1.0f, 1.0f);
+    if (material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor) == aiReturn_SUCCESS)
+        desc.baseColor = glm::vec3(diffuseColor.r, diffuseColor.g, diffuseColor.b);
+
+    aiColor3D emissiveColor(0.0f, 0.0f, 0.0f);
+    material->Get(AI_MATKEY_COLOR_EMISSIVE, emissiveColor);
+    desc.emissiveFactor = glm::vec3(emissiveColor.r, emissiveColor.g, emissiveColor.b);
+#ifdef AI_MATKEY_EMISSIVE_INTENSITY
+    float emissiveIntensity = 1.0f;
+    if (material->Get(AI_MATKEY_EMISSIVE_INTENSITY, emissiveIntensity) == aiReturn_SUCCESS)
+        desc.emissiveFactor *= emissiveIntensity;
+#endif
+
+    int twoSided = 0;
+    if (material->Get(AI_MATKEY_TWOSIDED, twoSided) == aiReturn_SUCCESS)
+        desc.twoSided = twoSided != 0;
+
+    return desc;
+}
+
+std::shared_ptr<Material> Mesh::createMaterial(const MeshMaterialDesc& desc)
+{
+    std::shared_ptr<PBRMaterial> matPtr = std::make_shared<PBRMaterial>(nullptr);
+    matPtr->setBaseColor(desc.baseColor);
+    matPtr->setEmissive(desc.emissiveFactor, nullptr);
+    matPtr->setTwoSided(desc.twoSided);
+    for (int slot = 0; slot < (int)MeshTextureSlot::Count; slot++)
+        requestTexture(desc.textures[slot], (MeshTextureSlot)slot, matPtr);
+    return matPtr;
 }
@@ -1,50 +1,99 @@
 #pragma once
+#include <future>
 #include <vector>
 #include "Core/Hittable.h"
+#include "Core/MeshCache.h"
+#include "Core/MemoryTracker.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
 
+class Texture;
+class PBRMaterial;
+
+// Wall clock time of each loading stage. Textures decode while the triangles are built,
+// so textureSeconds runs from the start of the decodes until the last one finished.
+// A mesh loaded from its cache spends parseSeconds validating and mapping the cache file and builds no BVH.
+struct MeshLoadTimings
+{
+    double parseSeconds = 0.0;
+    double triangleSeconds = 0.0;
+    double textureSeconds = 0.0;
+    double bvhSeconds = 0.0;
+    bool fromCache = false;
+};
+
+// Triangle mesh stored as flat vertex and index buffers with a flat BVH. After the first import the processed
+// buffers are written to a MeshCache file, later loads map that file and skip the importer and the BVH build.
+// With the compact vertex format the vertices are quantized to PackedVertex, see SetVertexFormat.
 class Mesh : public Hittable
 {
 public:
-	Mesh(glm::mat4 model, std::string const& location);
+    static constexpr unsigned int ImportFlags = aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices;
 
-    virtual bool Hit(const Ray& r, float tMin, float tMax, HitRecord& rec) const override
-    {
-        if (!boundingBox->Hit(r, tMin, tMax))
-            return false;
+	Mesh(glm::mat4 model, std::string const& location);
 
-        HitRecord tempRec;
-        bool hitAnything = false;
-        auto closestSoFar = tMax;
+    // Format of meshes created from now on. Compact vertices take a third of the memory, positions snap to
+    // 1/65535 of the mesh's extent and shading attributes lose some precision.
+    static void SetVertexFormat(MeshVertexFormat format) { vertexFormat = format; }
+    static MeshVertexFormat VertexFormat() { return vertexFormat; }
 
-        for (const auto tri : triangles) {
-            if (tri->Hit(r, tMin, closestSoFar, tempRec)) {
-                hitAnything = true;
-                closestSoFar = tempRec.t;
-                rec = tempRec;
-            }
-        }
+    const MeshLoadTimings& LoadTimings() const { return loadTimings; }
+    size_t TriangleCount() const { return geometry.triangleCount; }
 
-        return hitAnything;
-    }
+    virtual bool Hit(const Ray& r, float tMin, float tMax, HitRecord& rec) const override;
 
     virtual bool BoundingBox(AABB& outputBox) const
     {
+        if (!boundingBox)
+            return false;
         outputBox = *boundingBox;
         return true;
     }
 
+    virtual void CollectEmitters(std::vector<LightTriangle>& lights) override;
+
 private:
+    static inline MeshVertexFormat vertexFormat = MeshVertexFormat::Full;
+
     std::shared_ptr<AABB> boundingBox;
     glm::mat4 modelMatrix;
-	std::vector<std::shared_ptr<Hittable>> triangles;
-    std::shared_ptr<Material> matPtr;
+    MeshGeometry geometry; //Points into the storage vectors or into cacheFile
+    std::shared_ptr<MappedFile> cacheFile;
+    std::vector<Vertex> vertexStorage; //Emptied after import when the vertices are packed
+    std::vector<PackedVertex> packedVertexStorage;
+    std::vector<uint32_t> indexStorage;
+    std::vector<uint32_t> materialIndexStorage;
+    std::vector<MeshBVHNode> nodeStorage;
+    std::vector<int> lightIndices; //Per triangle, only filled if the mesh has emissive materials
+    std::vector<std::shared_ptr<Material>> materials;
     std::string directory;
-    std::vector<std::string> loadedTextures;
+    MeshLoadTimings loadTimings;
+    TrackedMemory triangleMemory{ MemoryCategory::Triangles };
+    TrackedMemory nodeMemory{ MemoryCategory::BvhNodes };
+
+    // Texture of a material that is still decoding, attached once the triangles are built
+    struct PendingTexture
+    {
+        std::shared_ptr<PBRMaterial> material;
+        MeshTextureSlot slot;
+        std::shared_future<std::shared_ptr<Texture>> texture;
+    };
+    std::vector<PendingTexture> pendingTextures;
+
+    // Closest hit with vertices read through one of the vertex formats
+    template<typename Vertices>
+    bool hitGeometry(const Vertices& vertices, const Ray& r, float tMin, float tMax, HitRecord& rec) const;
+
+    bool import(const std::string& location, MeshVertexFormat format, std::vector<MeshMaterialDesc>& descs);
+    // Fills the vertex storage, global indices and per triangle material slots of any format assimp reads
+    bool importAssimp(const std::string& location, std::vector<MeshMaterialDesc>& descs, std::vector<uint32_t>& indices, std::vector<uint32_t>& materialIndices);
+    MeshMaterialDesc describeMaterial(aiMaterial* material) const;
+    std::shared_ptr<Material> createMaterial(const MeshMaterialDesc& desc);
+    void requestTexture(const std::string& path, MeshTextureSlot slot, const std::shared_ptr<PBRMaterial>& matPtr);
 
-    void processNode(aiNode* node, const aiScene* scene, float& xMin, float& yMin, float& zMin, float& xMax, float& yMax, float& zMax);
-    void processMesh(aiMesh* mesh, const aiScene* scene, float& xMin, float& yMin, float& zMin, float& xMax, float& yMax, float& zMax);
+    void processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes);
+    // Transforms vertices [firstVertex, lastVertex) of mesh into world space starting at out
+    void processVertices(aiMesh* mesh, unsigned int firstVertex, unsigned int lastVertex, Vertex* out) const;
 
 };
\ No newline at end of file
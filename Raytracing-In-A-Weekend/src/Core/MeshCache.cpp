@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "Core/GltfLoader.h"
+#include "Core/MeshCache.h"
+
+namespace
+{
+	const char cacheMagic[4] = { 'R', 'T', 'M', 'C' };
+	const uint64_t arrayAlignment = 64;
+
+	// Fixed part of a material, followed by the bytes of its texture paths
+	struct MaterialRecord
+	{
+		float baseColor[3];
+		float emissiveFactor[3];
+		uint32_t twoSided;
+		uint32_t pathLengths[(int)MeshTextureSlot::Count];
+	};
+
+	//FNV-1a over 8 byte words, fast enough to hash a model's buffers when content hashing is on
+	uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const uint64_t prime = 0x100000001b3ull;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ bytes[i]) * prime;
+		return hash;
+	}
+
+	uint64_t hashFile(const std::string& path, bool contents, uint64_t hash)
+	{
+		//A missing file still changes the stamp, by its path
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(path, error);
+		int64_t time = error ? 0 : (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		if (error)
+			return hashBytes(path.data(), path.size(), hash);
+		uint64_t stamp[2] = { size, (uint64_t)time };
+		hash = hashBytes(stamp, sizeof(stamp), hash);
+		if (!contents)
+			return hash;
+		std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+		return file ? hashBytes(file->Data(), file->Size(), hash) : hash;
+	}
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + arrayAlignment - 1) / arrayAlignment * arrayAlignment;
+	}
+
+	bool inFile(uint64_t offset, uint64_t count, uint64_t elementBytes, uint64_t fileSize)
+	{
+		return offset % arrayAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementBytes;
+	}
+}
+
+uint64_t MeshCache::Key(const glm::mat4& model, uint32_t importFlags, MeshVertexFormat vertexFormat)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint32_t settings[6] = { Version, importFlags, (uint32_t)vertexFormat, (uint32_t)MeshBVH::LeafSize, (uint32_t)VertexBytes(vertexFormat), (uint32_t)sizeof(MeshBVHNode) };
+	hash = hashBytes(settings, sizeof(settings), hash);
+	for (int column = 0; column < 4; column++)
+	{
+		glm::vec4 values = model[column];
+		float components[4] = { values.x, values.y, values.z, values.w };
+		hash = hashBytes(components, sizeof(components), hash);
+	}
+	return hash;
+}
+
+uint64_t MeshCache::SourceStamp(const std::string& location)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashFile(location, hashContents, hash);
+
+	//Buffers the model keeps in separate files count as part of the source. A glTF names its own,
+	//for other formats every .bin next to the model is taken, they don't say which ones they read.
+	std::vector<std::string> buffers;
+	if (!GltfModel::Handles(location) || !GltfModel::BufferPaths(location, buffers))
+	{
+		std::error_code error;
+		std::filesystem::path directory = std::filesystem::path(location).parent_path();
+		if (directory.empty())
+			directory = ".";
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+		{
+			if (entry.path().extension() == ".bin")
+				buffers.push_back(entry.path().string());
+		}
+		std::sort(buffers.begin(), buffers.end());
+	}
+	for (const std::string& buffer : buffers)
+		hash = hashFile(buffer, hashContents, hash);
+	return hash;
+}
+
+std::shared_ptr<MappedFile> MeshCache::Open(const std::string& path, uint64_t key, uint64_t sourceStamp, MeshGeometry& geometry, std::vector<MeshMaterialDesc>& materials)
+{
+	std::error_code error;
+	if (!std::filesystem::exists(path, error))
+		return nullptr;
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+	if (!file || file->Size() < sizeof(MeshCacheHeader))
+		return nullptr;
+
+	MeshCacheHeader header;
+	memcpy(&header, file->Data(), sizeof(header));
+	uint64_t size = file->Size();
+	if (memcmp(header.magic, cacheMagic, 4) != 0 || header.version != Version || header.key != key || header.sourceStamp != sourceStamp || header.fileSize != size
+		|| header.vertexFormat > (uint32_t)MeshVertexFormat::Compact || header.nodeBytes != sizeof(MeshBVHNode) || header.nodeCount == 0)
+		return nullptr;
+	MeshVertexFormat vertexFormat = (MeshVertexFormat)header.vertexFormat;
+	if (header.vertexBytes != VertexBytes(vertexFormat))
+		return nullptr;
+	if (!inFile(header.vertexOffset, header.vertexCount, header.vertexBytes, size) || !inFile(header.indexOffset, header.triangleCount, 3 * sizeof(uint32_t), size)
+		|| !inFile(header.materialIndexOffset, header.triangleCount, sizeof(uint32_t), size) || !inFile(header.nodeOffset, header.nodeCount, sizeof(MeshBVHNode), size)
+		|| header.materialOffset > size)
+		return nullptr;
+
+	std::vector<MeshMaterialDesc> descs(header.materialCount);
+	uint64_t offset = header.materialOffset;
+	for (MeshMaterialDesc& desc : descs)
+	{
+		if (size - offset < sizeof(MaterialRecord))
+			return nullptr;
+		MaterialRecord record;
+		memcpy(&record, file->Data() + offset, sizeof(record));
+		offset += sizeof(record);
+		desc.baseColor = glm::vec3(record.baseColor[0], record.baseColor[1], record.baseColor[2]);
+		desc.emissiveFactor = glm::vec3(record.emissiveFactor[0], record.emissiveFactor[1], record.emissiveFactor[2]);
+		desc.twoSided = record.twoSided != 0;
+		for (int slot = 0; slot < (int)MeshTextureSlot::Count; slot++)
+		{
+			if (size - offset < record.pathLengths[slot])
+				return nullptr;
+			desc.textures[slot].assign(reinterpret_cast<const char*>(file->Data() + offset), record.pathLengths[slot]);
+			offset += record.pathLengths[slot];
+		}
+	}
+
+	//The mapping is page aligned and every array starts on a multiple of 64 bytes, so the arrays are used in place
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(file->Data() + header.indexOffset);
+	const uint32_t* materialIndices = reinterpret_cast<const uint32_t*>(file->Data() + header.materialIndexOffset);
+	const MeshBVHNode* nodes = reinterpret_cast<const MeshBVHNode*>(file->Data() + header.nodeOffset);
+
+	//Nothing is parsed, but a damaged tree must not send traversal out of bounds or past its stack. Only the nodes are read,
+	//a few percent of the file, the triangle arrays are trusted once the header and the file size agree.
+	std::vector<uint8_t> depths(header.nodeCount, 0); //Children always follow their parent, so one pass finds every depth
+	for (uint64_t i = 0; i < header.nodeCount; i++)
+	{
+		if (nodes[i].count > 0)
+		{
+			if ((uint64_t)nodes[i].offset + nodes[i].count > header.triangleCount)
+				return nullptr;
+			continue;
+		}
+		if (i + 1 >= header.nodeCount || nodes[i].offset <= i + 1 || nodes[i].offset >= header.nodeCount || nodes[i].axis > 2 || depths[i] + 1 >= MeshBVH::MaxDepth)
+			return nullptr;
+		depths[i + 1] = depths[nodes[i].offset] = depths[i] + 1;
+	}
+
+	geometry.vertexFormat = vertexFormat;
+	geometry.vertices = nullptr;
+	geometry.packedVertices = nullptr;
+	if (vertexFormat == MeshVertexFormat::Compact)
+	{
+		geometry.packedVertices = reinterpret_cast<const PackedVertex*>(file->Data() + header.vertexOffset);
+		geometry.quantization = header.quantization;
+	}
+	else
+		geometry.vertices = reinterpret_cast<const Vertex*>(file->Data() + header.vertexOffset);
+	geometry.indices = indices;
+	geometry.materialIndices = materialIndices;
+	geometry.nodes = nodes;
+	geometry.vertexCount = header.vertexCount;
+	geometry.triangleCount = header.triangleCount;
+	geometry.nodeCount = header.nodeCount;
+	materials = std::move(descs);
+	return file;
+}
+
+bool MeshCache::Write(const std::string& path, uint64_t key, uint64_t sourceStamp, const MeshGeometry& geometry, const std::vector<MeshMaterialDesc>& materials)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, cacheMagic, 4);
+	header.version = Version;
+	header.key = key;
+	header.sourceStamp = sourceStamp;
+	header.vertexBytes = (uint32_t)VertexBytes(geometry.vertexFormat);
+	header.nodeBytes = sizeof(MeshBVHNode);
+	header.vertexFormat = (uint32_t)geometry.vertexFormat;
+	header.quantization = geometry.quantization;
+	header.vertexCount = geometry.vertexCount;
+	header.triangleCount = geometry.triangleCount;
+	header.nodeCount = geometry.nodeCount;
+	header.materialCount = materials.size();
+	header.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+	header.indexOffset = alignOffset(header.vertexOffset + geometry.vertexCount * header.vertexBytes);
+	header.materialIndexOffset = alignOffset(header.indexOffset + geometry.triangleCount * 3 * sizeof(uint32_t));
+	header.nodeOffset = alignOffset(header.materialIndexOffset + geometry.triangleCount * sizeof(uint32_t));
+	header.materialOffset = alignOffset(header.nodeOffset + geometry.nodeCount * sizeof(MeshBVHNode));
+	header.fileSize = header.materialOffset;
+	for (const MeshMaterialDesc& desc : materials)
+	{
+		header.fileSize += sizeof(MaterialRecord);
+		for (const std::string& texture : desc.textures)
+			header.fileSize += texture.size();
+	}
+
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		uint64_t written = 0;
+		auto writeAt = [&out, &written](uint64_t offset, const void* data, uint64_t bytes)
+		{
+			static const char padding[arrayAlignment] = {};
+			if (offset > written)
+				out.write(padding, offset - written);
+			out.write(static_cast<const char*>(data), bytes);
+			written = offset + bytes;
+		};
+		writeAt(0, &header, sizeof(header));
+		if (geometry.vertexFormat == MeshVertexFormat::Compact)
+			writeAt(header.vertexOffset, geometry.packedVertices, geometry.vertexCount * header.vertexBytes);
+		else
+			writeAt(header.vertexOffset, geometry.vertices, geometry.vertexCount * header.vertexBytes);
+		writeAt(header.indexOffset, geometry.indices, geometry.triangleCount * 3 * sizeof(uint32_t));
+		writeAt(header.materialIndexOffset, geometry.materialIndices, geometry.triangleCount * sizeof(uint32_t));
+		writeAt(header.nodeOffset, geometry.nodes, geometry.nodeCount * sizeof(MeshBVHNode));
+		writeAt(header.materialOffset, nullptr, 0);
+		for (const MeshMaterialDesc& desc : materials)
+		{
+			MaterialRecord record = {};
+			for (int i = 0; i < 3; i++)
+			{
+				record.baseColor[i] = desc.baseColor[i];
+				record.emissiveFactor[i] = desc.emissiveFactor[i];
+			}
+			record.twoSided = desc.twoSided ? 1 : 0;
+			for (int slot = 0; slot < (int)MeshTextureSlot::Count; slot++)
+				record.pathLengths[slot] = (uint32_t)desc.textures[slot].size();
+			writeAt(written, &record, sizeof(record));
+			for (const std::string& texture : desc.textures)
+				writeAt(written, texture.data(), texture.size());
+		}
+		if (!out)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Core/Hittable.h"
+#include "Core/MappedFile.h"
+#include "Core/PackedVertex.h"
+#include "AccelerationStructures/MeshBvh.h"
+
+enum class MeshTextureSlot
+{
+	Diffuse,
+	Roughness,
+	Normal,
+	Emissive,
+	Count
+};
+
+// Full keeps every attribute as floats, Compact stores PackedVertex at a third of the size
+enum class MeshVertexFormat : uint32_t
+{
+	Full,
+	Compact
+};
+
+// Everything needed to recreate a mesh material without the importer. Texture paths are relative to the model.
+struct MeshMaterialDesc
+{
+	glm::vec3 baseColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	glm::vec3 emissiveFactor = glm::vec3(0.0f, 0.0f, 0.0f);
+	bool twoSided = false;
+	std::string textures[(int)MeshTextureSlot::Count];
+};
+
+// Processed geometry of a mesh: world space vertices, three indices and a material per triangle in BVH leaf order,
+// and the flat BVH over them. The arrays are owned by the mesh or by the mapped cache file.
+// Depending on the format either vertices or packedVertices is set.
+struct MeshGeometry
+{
+	MeshVertexFormat vertexFormat = MeshVertexFormat::Full;
+	const Vertex* vertices = nullptr;
+	const PackedVertex* packedVertices = nullptr;
+	VertexQuantization quantization;
+	const uint32_t* indices = nullptr;
+	const uint32_t* materialIndices = nullptr;
+	const MeshBVHNode* nodes = nullptr;
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	size_t nodeCount = 0;
+
+	// Decoded vertex in either format, for code outside the hit loop
+	Vertex VertexAt(size_t index) const
+	{
+		return packedVertices ? packedVertices[index].Unpack(quantization) : vertices[index];
+	}
+};
+
+struct MeshCacheHeader
+{
+	char magic[4]; //"RTMC"
+	uint32_t version;
+	uint64_t key;
+	uint64_t sourceStamp; //Sizes and modification times of the model and its buffers, see MeshCache::SourceStamp
+	uint32_t vertexBytes; //Layout checks, a cache from a build with other structs is rebuilt
+	uint32_t nodeBytes;
+	uint32_t vertexFormat; //MeshVertexFormat, vertexBytes is the size of its vertex
+	uint32_t reserved;
+	uint64_t vertexCount;
+	uint64_t triangleCount;
+	uint64_t nodeCount;
+	uint64_t materialCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t materialIndexOffset;
+	uint64_t nodeOffset;
+	uint64_t materialOffset;
+	VertexQuantization quantization; //Only used by compact vertices
+	uint64_t fileSize;
+};
+
+// Binary cache of a mesh's processed geometry, written next to the model after it was imported once.
+// The next load maps the file and uses the arrays in place, so neither the importer nor the BVH build run again.
+class MeshCache
+{
+public:
+	static constexpr uint32_t Version = 3;
+
+	// Hash of the transform and every setting that changes the output
+	static uint64_t Key(const glm::mat4& model, uint32_t importFlags, MeshVertexFormat vertexFormat);
+	// Hash of the size and modification time of the model file and the buffers it reads, only stats the files.
+	// With content hashing on their bytes are hashed as well, for sources whose times can't be trusted.
+	static uint64_t SourceStamp(const std::string& location);
+	static void SetContentHashing(bool enabled) { hashContents = enabled; }
+	static size_t VertexBytes(MeshVertexFormat vertexFormat) { return vertexFormat == MeshVertexFormat::Compact ? sizeof(PackedVertex) : sizeof(Vertex); }
+	// Each vertex format has its own file, so switching between them doesn't rebuild the other
+	static std::string CachePath(const std::string& location, MeshVertexFormat vertexFormat)
+	{
+		return location + (vertexFormat == MeshVertexFormat::Compact ? ".compact.meshcache" : ".meshcache");
+	}
+
+	// nullptr if the file is missing, was built for another key or is damaged. On success geometry points into the returned file.
+	static std::shared_ptr<MappedFile> Open(const std::string& path, uint64_t key, uint64_t sourceStamp, MeshGeometry& geometry, std::vector<MeshMaterialDesc>& materials);
+	// Writes to a temporary file first, so a concurrent or aborted load never sees half a cache
+	static bool Write(const std::string& path, uint64_t key, uint64_t sourceStamp, const MeshGeometry& geometry, const std::vector<MeshMaterialDesc>& materials);
+
+private:
+	static inline bool hashContents = false;
+};
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "Core/Numa.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+
+//From linux/mempolicy.h, spelled out so numactl's headers aren't needed
+static const int mempolicyDefault = 0;
+static const int mempolicyInterleave = 3;
+
+// Parses sysfs cpu lists like "0-7,16-23"
+static std::vector<int> parseCpuList(const std::string& list)
+{
+	std::vector<int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+	while (std::getline(stream, range, ','))
+	{
+		if (range.empty() || range == "\n")
+			continue;
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+#endif
+
+const NumaTopology& NumaTopology::Get()
+{
+	static NumaTopology topology;
+	return topology;
+}
+
+NumaTopology::NumaTopology()
+{
+#ifdef __linux__
+	std::vector<int> nodes;
+	if (DIR* directory = opendir("/sys/devices/system/node"))
+	{
+		while (dirent* entry = readdir(directory))
+		{
+			std::string name = entry->d_name;
+			if (name.rfind("node", 0) == 0 && name.size() > 4 && std::all_of(name.begin() + 4, name.end(), ::isdigit))
+				nodes.push_back(std::stoi(name.substr(4)));
+		}
+		closedir(directory);
+	}
+	std::sort(nodes.begin(), nodes.end());
+
+	for (int node : nodes)
+	{
+		std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string list;
+		if (!std::getline(file, list))
+			continue;
+		std::vector<int> cpus = parseCpuList(list);
+		if (!cpus.empty())
+		{
+			mNodeCpus.push_back(cpus);
+			mNodeIds.push_back(node);
+		}
+	}
+#endif
+
+	//No sysfs or memory only nodes: one node holding every core
+	if (mNodeCpus.empty())
+	{
+		int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+		mNodeCpus.push_back({});
+		mNodeIds.push_back(0);
+		for (int cpu = 0; cpu < cores; cpu++)
+			mNodeCpus[0].push_back(cpu);
+	}
+}
+
+int NumaTopology::CpuForWorker(int worker, int workerCount) const
+{
+	int node = (int)((int64_t)worker * NodeCount() / std::max(workerCount, 1));
+	int firstWorker = (int)(((int64_t)node * workerCount + NodeCount() - 1) / NodeCount());
+	const std::vector<int>& cpus = mNodeCpus[node];
+	return cpus[(worker - firstWorker) % cpus.size()];
+}
+
+bool pinCurrentThread(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool setMemoryInterleave(bool interleave)
+{
+#ifdef __linux__
+	if (NumaTopology::Get().NodeCount() < 2)
+		return false;
+
+	if (!interleave)
+		return syscall(SYS_set_mempolicy, mempolicyDefault, nullptr, 0) == 0;
+
+	unsigned long nodeMask = 0;
+	for (int node = 0; node < NumaTopology::Get().NodeCount(); node++)
+	{
+		if (NumaTopology::Get().NodeId(node) < (int)sizeof(nodeMask) * 8)
+			nodeMask |= 1ul << NumaTopology::Get().NodeId(node);
+	}
+	return syscall(SYS_set_mempolicy, mempolicyInterleave, &nodeMask, sizeof(nodeMask) * 8 + 1) == 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+
+struct NumaSettings
+{
+	bool pinThreads = false;			//Bind every render worker to one core, filling one NUMA node after the other
+	bool interleaveSceneMemory = false;	//Spread scene data loaded by the render thread over all nodes' memory
+};
+
+// CPUs of every NUMA node as reported by Linux sysfs. Other platforms and single socket machines show up as one node.
+class NumaTopology
+{
+public:
+	static const NumaTopology& Get();
+
+	int NodeCount() const { return (int)mNodeCpus.size(); }
+	const std::vector<int>& NodeCpus(int node) const { return mNodeCpus[node]; }
+	int NodeId(int node) const { return mNodeIds[node]; }
+
+	// CPU for worker out of workerCount, workers are split into one contiguous block per node
+	int CpuForWorker(int worker, int workerCount) const;
+
+private:
+	NumaTopology();
+
+	std::vector<std::vector<int>> mNodeCpus;
+	std::vector<int> mNodeIds; //Kernel node numbers, they may have gaps
+};
+
+// Pins the calling thread to cpu, false where that isn't supported
+bool pinCurrentThread(int cpu);
+
+// Interleaves the calling thread's future page allocations over all nodes, or restores the default local policy.
+// Does nothing and returns false on single node machines and outside Linux.
+bool setMemoryInterleave(bool interleave);
+
+// Turns on interleaving for the calling thread for as long as it lives
+class ScopedMemoryInterleave
+{
+public:
+	ScopedMemoryInterleave(bool enable) : active(enable && setMemoryInterleave(true)) {}
+	~ScopedMemoryInterleave()
+	{
+		if (active)
+			setMemoryInterleave(false);
+	}
+
+private:
+	bool active;
+};
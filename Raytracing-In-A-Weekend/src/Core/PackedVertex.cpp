@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include "Core/PackedVertex.h"
+
+namespace
+{
+	uint16_t quantize(float value, float offset, float scale)
+	{
+		if (scale <= 0.0f)
+			return 0;
+		return (uint16_t)std::clamp((value - offset) / scale + 0.5f, 0.0f, 65535.0f);
+	}
+
+	uint16_t toSnorm(float value)
+	{
+		return (uint16_t)(int16_t)std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+	}
+
+	float fromSnorm(uint16_t value)
+	{
+		return std::max((int16_t)value / 32767.0f, -1.0f);
+	}
+
+	float signNotZero(float value)
+	{
+		return value < 0.0f ? -1.0f : 1.0f;
+	}
+
+	//Projects the direction onto an octahedron and unfolds its lower half over the corners of the square
+	uint32_t octEncode(const glm::vec3& direction)
+	{
+		float length = fabs(direction.x) + fabs(direction.y) + fabs(direction.z);
+		if (length == 0.0f)
+			return 0;
+		glm::vec3 n = direction / length;
+		float x = n.x;
+		float y = n.y;
+		if (n.z < 0.0f)
+		{
+			x = (1.0f - fabs(n.y)) * signNotZero(n.x);
+			y = (1.0f - fabs(n.x)) * signNotZero(n.y);
+		}
+		return (uint32_t)toSnorm(x) | ((uint32_t)toSnorm(y) << 16);
+	}
+
+	glm::vec3 octDecode(uint32_t encoded)
+	{
+		float x = fromSnorm((uint16_t)(encoded & 0xFFFF));
+		float y = fromSnorm((uint16_t)(encoded >> 16));
+		glm::vec3 n(x, y, 1.0f - fabs(x) - fabs(y));
+		if (n.z < 0.0f)
+		{
+			n.x = (1.0f - fabs(y)) * signNotZero(x);
+			n.y = (1.0f - fabs(x)) * signNotZero(y);
+		}
+		return glm::normalize(n);
+	}
+}
+
+VertexQuantization VertexQuantization::FromVertices(const std::vector<Vertex>& vertices)
+{
+	glm::vec3 minimum(infinity, infinity, infinity);
+	glm::vec3 maximum(-infinity, -infinity, -infinity);
+	glm::vec2 uvMinimum(infinity, infinity);
+	glm::vec2 uvMaximum(-infinity, -infinity);
+	for (const Vertex& vertex : vertices)
+	{
+		minimum = glm::min(minimum, vertex.position);
+		maximum = glm::max(maximum, vertex.position);
+		if (vertex.textureCoord.x != -1.0f)
+		{
+			uvMinimum = glm::min(uvMinimum, glm::vec2(vertex.textureCoord));
+			uvMaximum = glm::max(uvMaximum, glm::vec2(vertex.textureCoord));
+		}
+	}
+
+	VertexQuantization quantization;
+	if (vertices.empty())
+		return quantization;
+	quantization.positionOffset = minimum;
+	quantization.positionScale = (maximum - minimum) / 65535.0f;
+	if (uvMinimum.x <= uvMaximum.x)
+	{
+		quantization.uvOffset = uvMinimum;
+		quantization.uvScale = (uvMaximum - uvMinimum) / 65535.0f;
+	}
+	return quantization;
+}
+
+PackedVertex PackedVertex::Pack(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	PackedVertex packed = {};
+	for (int axis = 0; axis < 3; axis++)
+		packed.position[axis] = quantize(vertex.position[axis], quantization.positionOffset[axis], quantization.positionScale[axis]);
+
+	if (vertex.normal.x != 0.0f || vertex.normal.y != 0.0f || vertex.normal.z != 0.0f)
+	{
+		packed.flags |= HasNormal;
+		packed.normal = octEncode(vertex.normal);
+	}
+	if (vertex.textureCoord.x != -1.0f)
+	{
+		packed.flags |= HasUv;
+		packed.uv[0] = quantize(vertex.textureCoord.x, quantization.uvOffset.x, quantization.uvScale.x);
+		packed.uv[1] = quantize(vertex.textureCoord.y, quantization.uvOffset.y, quantization.uvScale.y);
+	}
+	if (vertex.tangent.x != -1.0f)
+	{
+		packed.flags |= HasTangent;
+		packed.tangent = octEncode(vertex.tangent);
+		if (glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f)
+			packed.flags |= BitangentNegative;
+	}
+	return packed;
+}
+
+Vertex PackedVertex::Unpack(const VertexQuantization& quantization) const
+{
+	Vertex vertex;
+	vertex.position = Position(quantization);
+	vertex.normal = (flags & HasNormal) ? octDecode(normal) : glm::vec3(0.0f, 0.0f, 0.0f);
+	vertex.textureCoord = glm::vec3(-1.0f, 0.0f, 0.0f);
+	if (flags & HasUv)
+		vertex.textureCoord = glm::vec3(quantization.uvOffset + glm::vec2(uv[0], uv[1]) * quantization.uvScale, 0.0f);
+	vertex.tangent = glm::vec3(-1.0f, 0.0f, 0.0f);
+	vertex.bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+	if (flags & HasTangent)
+	{
+		vertex.tangent = octDecode(tangent);
+		vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * ((flags & BitangentNegative) ? -1.0f : 1.0f);
+	}
+	return vertex;
+}
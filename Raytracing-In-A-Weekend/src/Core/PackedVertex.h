@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Core/Hittable.h"
+
+// Ranges the 16 bit positions and uvs of a mesh are fractions of, value = offset + quantized * scale
+struct VertexQuantization
+{
+	glm::vec3 positionOffset = glm::vec3(0.0f, 0.0f, 0.0f);
+	glm::vec3 positionScale = glm::vec3(0.0f, 0.0f, 0.0f);
+	glm::vec2 uvOffset = glm::vec2(0.0f, 0.0f);
+	glm::vec2 uvScale = glm::vec2(0.0f, 0.0f);
+
+	// Bounds of all positions and of the uvs of vertices that have some
+	static VertexQuantization FromVertices(const std::vector<Vertex>& vertices);
+};
+
+// A third of the size of Vertex. Positions and uvs are 16 bit fractions of the mesh's bounds, normal and tangent
+// are octahedral with 16 bits per axis and the bitangent is rebuilt from the normal, the tangent and a sign.
+// Only the position is decoded while searching for the closest hit, the rest once for the hit that is kept.
+struct PackedVertex
+{
+	enum Flags : uint16_t
+	{
+		HasNormal = 1,
+		HasUv = 2,
+		HasTangent = 4,
+		BitangentNegative = 8
+	};
+
+	uint16_t position[3];
+	uint16_t flags;
+	uint16_t uv[2];
+	uint32_t normal;
+	uint32_t tangent;
+
+	static PackedVertex Pack(const Vertex& vertex, const VertexQuantization& quantization);
+
+	glm::vec3 Position(const VertexQuantization& quantization) const
+	{
+		return quantization.positionOffset + glm::vec3(position[0], position[1], position[2]) * quantization.positionScale;
+	}
+
+	// Missing attributes come back as the markers the hit code expects, a zero normal and uv and tangent x of -1
+	Vertex Unpack(const VertexQuantization& quantization) const;
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex is stored in mesh cache files");
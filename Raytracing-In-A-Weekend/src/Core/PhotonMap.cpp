@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <iostream>
+#include "Core/PhotonMap.h"
+#include "Material/Material.h"
+
+PhotonMap::PhotonMap(const Hittable& world, const LightBVH& lights, const PhotonMapSettings& settings, ThreadPool& threadPool)
+	: mSettings(settings)
+{
+	const std::vector<LightTriangle>& emitters = lights.Lights();
+	if (emitters.empty() || mSettings.photonCount <= 0)
+		return;
+
+	std::vector<float> powers;
+	for (const LightTriangle& light : emitters)
+		powers.push_back(light.power);
+	AliasTable lightTable(powers);
+
+	//Every render thread traces its share into its own list, merged afterwards
+	int threadCount = threadPool.ThreadCount();
+	std::vector<std::vector<Photon>> threadPhotons(threadCount);
+	for (int i = 0; i < threadCount; i++)
+	{
+		int count = mSettings.photonCount / threadCount + (i < mSettings.photonCount % threadCount ? 1 : 0);
+		threadPool.Submit([this, &world, &lights, &lightTable, count, &threadPhotons, i]
+			{
+				tracePhotons(world, lights, lightTable, count, threadPhotons[i]);
+			});
+	}
+	threadPool.Wait();
+
+	for (std::vector<Photon>& photons : threadPhotons)
+		mPhotons.insert(mPhotons.end(), photons.begin(), photons.end());
+
+	//Sort into a hash grid with cells the size of the gather radius
+	std::vector<std::pair<uint64_t, uint32_t>> keys(mPhotons.size());
+	for (uint32_t i = 0; i < (uint32_t)mPhotons.size(); i++)
+		keys[i] = { cellKey(mPhotons[i].p), i };
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<Photon> sorted(mPhotons.size());
+	for (uint32_t i = 0; i < (uint32_t)keys.size(); i++)
+	{
+		sorted[i] = mPhotons[keys[i].second];
+		if (i == 0 || keys[i].first != keys[i - 1].first)
+			mCells[keys[i].first] = { i, i + 1 };
+		else
+			mCells[keys[i].first].second = i + 1;
+	}
+	mPhotons.swap(sorted);
+
+	std::cerr << "Photon map: " << mPhotons.size() << " caustic photons stored." << std::endl;
+}
+
+void PhotonMap::tracePhotons(const Hittable& world, const LightBVH& lights, const AliasTable& lightTable, int count, std::vector<Photon>& stored) const
+{
+	const std::vector<LightTriangle>& emitters = lights.Lights();
+
+	for (int i = 0; i < count; i++)
+	{
+		int lightIndex = lightTable.Sample(randomFloat());
+		const LightTriangle& light = emitters[lightIndex];
+
+		//Uniform point on the triangle, cosine weighted direction from the emitting side
+		float su0 = sqrt(randomFloat());
+		float b0 = 1.0f - su0;
+		float b1 = randomFloat() * su0;
+		float b2 = 1.0f - b0 - b1;
+		glm::vec3 origin = b0 * light.p0 + b1 * light.p1 + b2 * light.p2;
+		glm::vec2 uv = b0 * light.uv0 + b1 * light.uv1 + b2 * light.uv2;
+
+		glm::vec3 normal = light.normal;
+		if (light.twoSided && randomFloat() < 0.5f)
+			normal = -normal;
+
+		glm::vec3 direction = normal + randomUnitVector();
+		if (vecNearZero(direction))
+			direction = normal;
+
+		HitRecord lightRec;
+		lightRec.p = origin;
+		lightRec.u = uv.x;
+		lightRec.v = uv.y;
+		lightRec.normal = normal;
+		lightRec.frontFace = normal == light.normal;
+		lightRec.matPtr = light.matPtr;
+		glm::vec3 radiance = light.matPtr->emitted(Ray(origin + normal, -normal), lightRec, uv.x, uv.y, origin);
+
+		//Le * cos / (pdf_position * pdf_direction) over all emitted photons
+		float sides = light.twoSided ? 2.0f : 1.0f;
+		glm::vec3 power = radiance * (pi * light.area * sides / (lightTable.Pmf(lightIndex) * mSettings.photonCount));
+
+		Ray ray(origin, direction);
+		bool specularChain = false;
+		for (int bounce = 0; bounce < mSettings.maxBounces; bounce++)
+		{
+			HitRecord rec;
+			if (!world.Hit(ray, 0.001f, infinity, rec))
+				break;
+
+			if (rec.matPtr->isDiffuse(rec))
+			{
+				if (specularChain)
+					stored.push_back({ rec.p, glm::normalize(ray.direction), power });
+				break;
+			}
+			if (!rec.matPtr->isSpecular(rec))
+				break;
+
+			Ray scattered;
+			glm::vec3 attenuation;
+			if (!rec.matPtr->scatter(ray, rec, attenuation, scattered))
+				break;
+
+			power *= attenuation;
+			ray = scattered;
+			specularChain = true;
+		}
+	}
+}
+
+uint64_t PhotonMap::cellKey(int64_t x, int64_t y, int64_t z) const
+{
+	const int64_t offset = int64_t(1) << 20;
+	return (((uint64_t)(x + offset) & 0x1FFFFF) << 42) | (((uint64_t)(y + offset) & 0x1FFFFF) << 21) | ((uint64_t)(z + offset) & 0x1FFFFF);
+}
+
+uint64_t PhotonMap::cellKey(const glm::vec3& p) const
+{
+	return cellKey((int64_t)floor(p.x / mSettings.gatherRadius), (int64_t)floor(p.y / mSettings.gatherRadius), (int64_t)floor(p.z / mSettings.gatherRadius));
+}
+
+glm::vec3 PhotonMap::Estimate(const Ray& rIn, const HitRecord& rec) const
+{
+	glm::vec3 sum(0.0f, 0.0f, 0.0f);
+	if (mPhotons.empty())
+		return sum;
+
+	const float radius = mSettings.gatherRadius;
+	int64_t cx = (int64_t)floor(rec.p.x / radius);
+	int64_t cy = (int64_t)floor(rec.p.y / radius);
+	int64_t cz = (int64_t)floor(rec.p.z / radius);
+
+	for (int64_t dx = -1; dx <= 1; dx++)
+	for (int64_t dy = -1; dy <= 1; dy++)
+	for (int64_t dz = -1; dz <= 1; dz++)
+	{
+		auto cell = mCells.find(cellKey(cx + dx, cy + dy, cz + dz));
+		if (cell == mCells.end())
+			continue;
+
+		for (uint32_t i = cell->second.first; i < cell->second.second; i++)
+		{
+			const Photon& photon = mPhotons[i];
+			glm::vec3 d = photon.p - rec.p;
+			if (glm::dot(d, d) > radius * radius)
+				continue;
+
+			glm::vec3 wi = -photon.direction;
+			float cosine = glm::dot(rec.normal, wi);
+			if (cosine <= 0.0f)
+				continue;
+
+			//evaluate() includes the cosine, the photon power already carries it
+			sum += rec.matPtr->evaluate(rIn, rec, wi) / cosine * photon.power;
+		}
+	}
+
+	return sum / (pi * radius * radius);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "Core/Hittable.h"
+#include "Core/AliasTable.h"
+#include "Core/ThreadPool.h"
+#include "AccelerationStructures/LightBvh.h"
+
+struct PhotonMapSettings
+{
+	bool enabled = false;		//Only takes effect in scenes with emissive triangles
+	int photonCount = 500000;	//Photons emitted, only those reaching a diffuse surface through glass or mirrors are kept
+	float gatherRadius = 4.0f;	//World space radius of the density estimate
+	int maxBounces = 16;
+};
+
+struct Photon
+{
+	glm::vec3 p;
+	glm::vec3 direction; //Direction of travel when it landed
+	glm::vec3 power;
+};
+
+// Caustic photon map: photons shot from the emissive triangles, stored where a specular chain ends on a diffuse surface.
+// Paths of that shape (light -> specular -> diffuse) are left to the map instead of the path tracer.
+// The environment and background don't emit photons, their caustics are still found by the path tracer alone.
+class PhotonMap
+{
+public:
+	// Traces the photons as jobs on threadPool, which must have no other work queued
+	PhotonMap(const Hittable& world, const LightBVH& lights, const PhotonMapSettings& settings, ThreadPool& threadPool);
+
+	// Reflected caustic radiance at a diffuse hit
+	glm::vec3 Estimate(const Ray& rIn, const HitRecord& rec) const;
+
+	size_t Size() const { return mPhotons.size(); }
+
+private:
+	PhotonMapSettings mSettings;
+	std::vector<Photon> mPhotons; //Sorted by grid cell
+	std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> mCells; //Cell key to [begin, end) in mPhotons
+
+	void tracePhotons(const Hittable& world, const LightBVH& lights, const AliasTable& lightTable, int count, std::vector<Photon>& stored) const;
+	uint64_t cellKey(const glm::vec3& p) const;
+	uint64_t cellKey(int64_t x, int64_t y, int64_t z) const;
+};
@@ -6,6 +6,7 @@
 #include <memory>
 #include <cstdlib>
 #include <random>
+#include <atomic>
 
 // Usings
 using std::sqrt;
@@ -25,8 +26,10 @@ inline float degreesToRadians(float degrees) {
 
 inline float randomFloat()
 {
-	static std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-	static std::mt19937 generator;
+	//One generator per thread, seeded in order of first use so single threaded runs stay reproducible
+	static std::atomic<uint32_t> seedCounter(0);
+	thread_local std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	thread_local std::mt19937 generator(std::mt19937::default_seed + seedCounter++);
 	return distribution(generator);
 }
 
@@ -42,6 +45,21 @@ inline float clamp(float x, float min, float max)
 	return x;
 }
 
+inline float luminance(const glm::vec3& color)
+{
+	return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Multiple importance sampling weight for a sample drawn from f, with g as the competing strategy
+inline float powerHeuristic(float fPdf, float gPdf)
+{
+	float f2 = fPdf * fPdf;
+	float g2 = gPdf * gPdf;
+	if (f2 + g2 == 0.0f)
+		return 0.0f;
+	return f2 / (f2 + g2);
+}
+
 inline glm::vec3 randomVec()
 {
 	return glm::vec3(randomFloat(), randomFloat(), randomFloat());
@@ -0,0 +1,80 @@
+#include "Core/RadianceCache.h"
+
+static const int maxProbes = 16;
+
+RadianceCache::RadianceCache(const RadianceCacheSettings& settings, size_t capacity)
+	: mSettings(settings), mCapacity(1)
+{
+	while (mCapacity < capacity)
+		mCapacity <<= 1;
+	mEntries = std::make_unique<Entry[]>(mCapacity);
+}
+
+uint64_t RadianceCache::cellKey(const glm::vec3& p, const glm::vec3& n) const
+{
+	//20 bits per axis around the origin plus one of six normal directions
+	const int64_t offset = int64_t(1) << 19;
+	uint64_t x = (uint64_t)((int64_t)floor(p.x / mSettings.cellSize) + offset) & 0xFFFFF;
+	uint64_t y = (uint64_t)((int64_t)floor(p.y / mSettings.cellSize) + offset) & 0xFFFFF;
+	uint64_t z = (uint64_t)((int64_t)floor(p.z / mSettings.cellSize) + offset) & 0xFFFFF;
+
+	glm::vec3 a(fabs(n.x), fabs(n.y), fabs(n.z));
+	uint64_t axis = (a.x >= a.y && a.x >= a.z) ? 0 : (a.y >= a.z ? 1 : 2);
+	uint64_t normalBucket = axis * 2 + (n[(int)axis] < 0.0f ? 1 : 0);
+
+	//Top bit set so no valid key is 0, which marks an empty slot
+	return (uint64_t(1) << 63) | (normalBucket << 60) | (x << 40) | (y << 20) | z;
+}
+
+RadianceCache::Entry* RadianceCache::find(uint64_t key, bool insert) const
+{
+	uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+	hash ^= hash >> 32;
+
+	for (int probe = 0; probe < maxProbes; probe++)
+	{
+		Entry& entry = mEntries[(hash + probe) & (mCapacity - 1)];
+		uint64_t current = entry.key.load(std::memory_order_acquire);
+		if (current == key)
+			return &entry;
+		if (current == 0)
+		{
+			if (!insert)
+				return nullptr;
+			uint64_t expected = 0;
+			if (entry.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel) || expected == key)
+				return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+bool RadianceCache::Lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& radiance) const
+{
+	Entry* entry = find(cellKey(p, n), false);
+	if (!entry)
+		return false;
+
+	uint32_t count = entry->count.load(std::memory_order_relaxed);
+	if (count < (uint32_t)mSettings.minSamples)
+		return false;
+
+	radiance = glm::vec3(entry->r.load(std::memory_order_relaxed), entry->g.load(std::memory_order_relaxed), entry->b.load(std::memory_order_relaxed)) / (float)count;
+	return true;
+}
+
+void RadianceCache::Update(const glm::vec3& p, const glm::vec3& n, const glm::vec3& radiance)
+{
+	if (!(radiance.x == radiance.x && radiance.y == radiance.y && radiance.z == radiance.z))
+		return;
+
+	Entry* entry = find(cellKey(p, n), true);
+	if (!entry)
+		return;
+
+	entry->r.fetch_add(radiance.x, std::memory_order_relaxed);
+	entry->g.fetch_add(radiance.y, std::memory_order_relaxed);
+	entry->b.fetch_add(radiance.z, std::memory_order_relaxed);
+	entry->count.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "Core/RTWeekend.h"
+
+struct RadianceCacheSettings
+{
+	bool enabled = false;
+	int startBounce = 2;	//Bounces traced exactly before the cache may terminate a path
+	float cellSize = 5.0f;	//World space size of a grid cell, bigger means more bias but faster convergence
+	int minSamples = 16;	//Samples a cell needs before lookups trust it
+};
+
+// Spatial hash grid of outgoing diffuse radiance keyed by position and normal.
+// Entries are claimed and accumulated with atomics only, so all render threads can share one cache.
+class RadianceCache
+{
+public:
+	RadianceCache(const RadianceCacheSettings& settings, size_t capacity = size_t(1) << 20);
+
+	bool Lookup(const glm::vec3& p, const glm::vec3& n, glm::vec3& radiance) const;
+	void Update(const glm::vec3& p, const glm::vec3& n, const glm::vec3& radiance);
+
+	int StartBounce() const { return mSettings.startBounce; }
+
+private:
+	struct Entry
+	{
+		std::atomic<uint64_t> key{ 0 };
+		std::atomic<float> r{ 0.0f }, g{ 0.0f }, b{ 0.0f };
+		std::atomic<uint32_t> count{ 0 };
+	};
+
+	RadianceCacheSettings mSettings;
+	size_t mCapacity;
+	std::unique_ptr<Entry[]> mEntries;
+
+	uint64_t cellKey(const glm::vec3& p, const glm::vec3& n) const;
+	Entry* find(uint64_t key, bool insert) const;
+};
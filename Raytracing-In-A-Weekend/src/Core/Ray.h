@@ -13,4 +13,7 @@ public:
 
 public:
 	glm::vec3 origin, direction;
+	//Ray cone for texture filtering: width at the origin and spread angle in radians, zero picks the finest mip level
+	float coneWidth = 0.0f;
+	float coneSpread = 0.0f;
 };
\ No newline at end of file
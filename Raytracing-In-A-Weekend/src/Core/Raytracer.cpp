@@ -1,49 +1,200 @@
 ﻿#include "Core/Raytracer.h"
 
-glm::vec3 Raytracer::rayColor(const Ray& r, int depth)
+//Counted per thread and handed to the render job once per tile, a shared atomic would be bumped for every ray
+static thread_local int64_t threadRayCount = 0;
+
+//Added to the ray cone's spread at every non-specular bounce. Rough lobes scatter over a wide solid angle,
+//so textures seen through them are read from coarse mip levels.
+static const float roughConeSpread = 0.5f;
+
+int64_t Raytracer::takeRayCount()
+{
+	int64_t count = threadRayCount;
+	threadRayCount = 0;
+	return count;
+}
+
+glm::vec3 Raytracer::rayColor(const Ray& r, int depth, const ScatterInfo* prev)
 {
 	HitRecord rec;
 
 	if (depth <= 0)
 		return glm::vec3(0.0f, 0.0f, 0.0f);
 
+	threadRayCount++;
 	if (!mWorld.Hit(r, 0.001f, infinity, rec))
-		return mBackground;
+	{
+		if (!mEnvironment)
+			return mBackground;
+
+		glm::vec3 radiance = mEnvironment->Lookup(r.direction);
+		if (prev && !prev->specular)
+			radiance *= powerHeuristic(prev->pdf, environmentSelectProbability() * mEnvironment->Pdf(r.direction));
+		return radiance;
+	}
+
+	glm::vec3 emitted = rec.matPtr->emitted(r, rec, rec.u, rec.v, rec.p);
+	if (prev && !prev->specular && rec.lightIndex >= 0 && mLights)
+	{
+		//This emitter could also have been found by light sampling at the previous vertex
+		float lightPdf = (1.0f - environmentSelectProbability()) * mLights->Pdf(prev->p, prev->normal, rec.lightIndex, rec.p);
+		emitted *= powerHeuristic(prev->pdf, lightPdf);
+	}
+	if (mPhotonMap && prev && prev->specular && prev->causticPath && rec.lightIndex >= 0)
+		emitted = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	//Past the first few bounces a trusted cache entry ends the path
+	bool cacheVertex = mRadianceCache && rec.matPtr->isDiffuse(rec);
+	if (cacheVertex && mMaxDepth - depth >= mRadianceCache->StartBounce())
+	{
+		glm::vec3 cached;
+		if (mRadianceCache->Lookup(rec.p, rec.normal, cached))
+			return emitted + cached;
+	}
 
 	Ray scattered;
 	glm::vec3 attenuation;
-	glm::vec3 emitted = rec.matPtr->emitted(rec.u, rec.v, rec.p);
 	if (!rec.matPtr->scatter(r, rec, attenuation, scattered))
 		return emitted;
 
-	return emitted + attenuation * rayColor(scattered, depth - 1);
+	bool diffuse = rec.matPtr->isDiffuse(rec);
+	ScatterInfo info;
+	info.specular = rec.matPtr->isSpecular(rec);
+	scattered.coneWidth = r.coneWidth + r.coneSpread * rec.t * glm::length(r.direction);
+	scattered.coneSpread = r.coneSpread + (info.specular ? 0.0f : roughConeSpread);
+	info.causticPath = diffuse || (info.specular && prev && prev->causticPath);
+	glm::vec3 direct(0.0f, 0.0f, 0.0f);
+	if (mPhotonMap && diffuse)
+		direct += mPhotonMap->Estimate(r, rec);
+	if (!info.specular)
+	{
+		if (mLights || mEnvironment)
+			direct += sampleLights(r, rec);
+		info.p = rec.p;
+		info.normal = rec.normal;
+		info.pdf = rec.matPtr->scatteringPdf(r, rec, scattered.direction);
+	}
+
+	glm::vec3 reflected = direct + attenuation * rayColor(scattered, depth - 1, &info);
+	if (cacheVertex)
+		mRadianceCache->Update(rec.p, rec.normal, reflected);
+
+	return emitted + reflected;
 }
 
-void Raytracer::writeColor(glm::vec3 pixelColor, int samplesPerPixel, int lineNumber, int columnNumber)
+float Raytracer::environmentSelectProbability() const
 {
-	auto r = pixelColor.x;
-	auto g = pixelColor.y;
-	auto b = pixelColor.z;
+	if (!mEnvironment || !mEnvironment->Valid())
+		return 0.0f;
+	return (mLights && !mLights->Empty()) ? 0.5f : 1.0f;
+}
 
-	mOrigColorData[lineNumber * mImageWidth + columnNumber] = pixelColor;
+glm::vec3 Raytracer::sampleLights(const Ray& r, const HitRecord& rec)
+{
+	float environmentProbability = environmentSelectProbability();
+	if (environmentProbability > 0.0f && randomFloat() < environmentProbability)
+	{
+		glm::vec3 direction;
+		glm::vec3 radiance;
+		float pdf;
+		if (!mEnvironment->Sample(direction, radiance, pdf))
+			return glm::vec3(0.0f, 0.0f, 0.0f);
+		pdf *= environmentProbability;
 
-	auto scale = 1.0f / samplesPerPixel;
-	r = sqrt(scale * r);
-	g = sqrt(scale * g);
-	b = sqrt(scale * b);
+		glm::vec3 f = rec.matPtr->evaluate(r, rec, direction);
+		if (f.x == 0.0f && f.y == 0.0f && f.z == 0.0f)
+			return glm::vec3(0.0f, 0.0f, 0.0f);
 
-	int rValue = static_cast<int>(256 * clamp(r, 0.0f, 0.999f));
-	int gValue = static_cast<int>(256 * clamp(g, 0.0f, 0.999f));
-	int bValue = static_cast<int>(256 * clamp(b, 0.0f, 0.999f));
+		HitRecord shadowRec;
+		threadRayCount++;
+		if (mWorld.Hit(Ray(rec.p, direction), 0.001f, infinity, shadowRec))
+			return glm::vec3(0.0f, 0.0f, 0.0f);
+
+		float weight = powerHeuristic(pdf, rec.matPtr->scatteringPdf(r, rec, direction));
+		return f * radiance * weight / pdf;
+	}
+
+	LightSample lightSample;
+	if (!mLights || !mLights->Sample(rec.p, rec.normal, lightSample) || lightSample.pdf <= 0.0f)
+		return glm::vec3(0.0f, 0.0f, 0.0f);
+	lightSample.pdf *= 1.0f - environmentProbability;
+
+	glm::vec3 toLight = lightSample.p - rec.p;
+	glm::vec3 f = rec.matPtr->evaluate(r, rec, toLight);
+	if (f.x == 0.0f && f.y == 0.0f && f.z == 0.0f)
+		return glm::vec3(0.0f, 0.0f, 0.0f);
 
-	uint32_t index = (lineNumber * mImageWidth + columnNumber) * 4;
-	(*mImageTextureData)[index] = (GLubyte)rValue;
-	(*mImageTextureData)[index + 1] = (GLubyte)gValue;
-	(*mImageTextureData)[index + 2] = (GLubyte)bValue;
-	(*mImageTextureData)[index + 3] = (GLubyte)255;
+	HitRecord shadowRec;
+	threadRayCount++;
+	if (mWorld.Hit(Ray(rec.p, toLight), 0.001f, 0.9999f, shadowRec))
+		return glm::vec3(0.0f, 0.0f, 0.0f);
+
+	float weight = powerHeuristic(lightSample.pdf, rec.matPtr->scatteringPdf(r, rec, toLight));
+	return f * lightSample.radiance * weight / lightSample.pdf;
+}
+
+bool Raytracer::tonemapChanged(const TonemapSettings& tonemap)
+{
+	if (tonemap == mDisplayedTonemap)
+		return false;
+	mDisplayedTonemap = tonemap;
+	return true;
+}
+
+void Raytracer::writeDisplayRow(const glm::vec3* pixels, int count, int sampleCount, int lineNumber, int columnNumber, const TonemapSettings& tonemap)
+{
+	size_t index = ((size_t)lineNumber * mImageWidth + columnNumber) * 4;
+	::tonemap(pixels, count, sampleCount, tonemap, mImageTextureData->data() + index);
+}
+
+void Raytracer::buildPhotonMap(const PhotonMapSettings& photonMap, ThreadPool& threadPool)
+{
+	if (!photonMap.enabled)
+		return;
+	if (!mLights || mLights->Empty())
+	{
+		std::cerr << "Photon map skipped: photons are only shot from emissive triangles, caustics of the environment and background stay with the path tracer" << std::endl;
+		return;
+	}
+	mPhotonMap = std::make_unique<PhotonMap>(mWorld, *mLights, photonMap, threadPool);
+}
+
+bool Raytracer::renderRow(int x0, int x1, int j, int sampleCount, glm::vec3* row, bool overwrite)
+{
+	for (int i = x0; i < x1; ++i)
+	{
+		//Checked per pixel so cancelling stays quick with big tiles and many samples
+		if (mJob->Cancelled())
+			return false;
+
+		glm::vec3 pixelColor(0.0f, 0.0f, 0.0f);
+		for (int s = 0; s < sampleCount; ++s)
+		{
+			float u = (i + randomFloat()) / (mImageWidth - 1);
+			float v = (j + randomFloat()) / (mImageHeight - 1);
+			Ray r = mCamera.GetRay(u, v);
+			pixelColor += rayColor(r, mMaxDepth);
+		}
+		if (overwrite)
+			row[i - x0] = pixelColor;
+		else
+			row[i - x0] += pixelColor;
+	}
+	return true;
 }
 
 void RaytracerNormal::Run()
+{
+	if (mBuildUpRender)
+		mJob->Start((int64_t)mImageHeight * mSamplesPerPixel, mSamplesPerPixel, (int64_t)mImageWidth * mImageHeight * mSamplesPerPixel);
+	else
+		mJob->Start(mImageHeight, 1, (int64_t)mImageWidth * mImageHeight * mSamplesPerPixel);
+	takeRayCount();
+	render();
+	mJob->Finish();
+}
+
+void RaytracerNormal::render()
 {
 	if (mBuildUpRender)
 	{
@@ -51,35 +202,31 @@ void RaytracerNormal::Run()
 		{
 			for (int j = mImageHeight - 1; j >= 0; --j)
 			{
-				if (cancelRaytracer)
-					return;
-
 				for (int i = 0; i < mImageWidth; ++i)
 				{
-					glm::vec3 pixelColor;
-					if (s == 0)
-						pixelColor = glm::vec3(0.0f, 0.0f, 0.0f);
-					else
-						pixelColor = mOrigColorData[j * mImageWidth + i];
+					if (mJob->Cancelled())
+						return;
+
 					float u = (i + randomFloat()) / (mImageWidth - 1);
 					float v = (j + randomFloat()) / (mImageHeight - 1);
 					Ray r = mCamera.GetRay(u, v);
-					pixelColor += rayColor(r, mMaxDepth);
-					writeColor(pixelColor, s, j, i);
+					mOrigColorData[(size_t)j * mImageWidth + i] += rayColor(r, mMaxDepth);
 				}
+				publishRow(j, s + 1);
+				mJob->TileDone(mImageWidth, takeRayCount());
 			}
-			std::cerr << "Sample " << s << " Done." << std::endl;
+			mJob->PassDone();
 		}
 	}
 	else
 	{
 		for (int j = mImageHeight - 1; j >= 0; --j)
 		{
-			if (cancelRaytracer)
-				return;
-
 			for (int i = 0; i < mImageWidth; ++i)
 			{
+				if (mJob->Cancelled())
+					return;
+
 				glm::vec3 pixelColor(0.0f, 0.0f, 0.0f);
 				for (int s = 0; s < mSamplesPerPixel; ++s)
 				{
@@ -88,107 +235,258 @@ void RaytracerNormal::Run()
 					Ray r = mCamera.GetRay(u, v);
 					pixelColor += rayColor(r, mMaxDepth);
 				}
-				writeColor(pixelColor, mSamplesPerPixel, j, i);
+				mOrigColorData[(size_t)j * mImageWidth + i] = pixelColor;
 			}
+			publishRow(j, mSamplesPerPixel);
+			mJob->TileDone((int64_t)mImageWidth * mSamplesPerPixel, takeRayCount());
 		}
+		mJob->PassDone();
 	}
 }
 
-void RaytracerMT::writeLine(int lineNumber, int currentSample)
+void RaytracerNormal::publishRow(int j, int sampleCount)
 {
-	if (mBuildUpRender)
+	std::lock_guard<std::mutex> lock(mPublishMutex);
+	std::copy_n(mOrigColorData.data() + (size_t)j * mImageWidth, mImageWidth, mPublishedColorData.data() + (size_t)j * mImageWidth);
+	mRowSamples[j] = sampleCount;
+}
+
+void RaytracerNormal::UpdateDisplay(const TonemapSettings& tonemap)
+{
+	bool refreshAll = tonemapChanged(tonemap);
+	for (int j = 0; j < mImageHeight; ++j)
+	{
+		if (mRowSamples[j] == 0 || (mRowSamples[j] == mDisplayedRowSamples[j] && !refreshAll))
+			continue;
+
+		//Locked per row, so the render thread only waits for the conversion of a single row
+		std::lock_guard<std::mutex> lock(mPublishMutex);
+		int sampleCount = mRowSamples[j];
+		writeDisplayRow(mPublishedColorData.data() + (size_t)j * mImageWidth, mImageWidth, sampleCount, j, 0, tonemap);
+		mDisplayedRowSamples[j] = sampleCount;
+		mDirtyRegions.Add({ 0, j, mImageWidth, j + 1 });
+	}
+}
+
+void RaytracerNormal::ResolveLinear(std::vector<glm::vec3>& image) const
+{
+	image.assign((size_t)mImageWidth * mImageHeight, glm::vec3(0.0f, 0.0f, 0.0f));
+	std::lock_guard<std::mutex> lock(mPublishMutex);
+	for (int j = 0; j < mImageHeight; ++j)
 	{
+		int sampleCount = mRowSamples[j];
+		if (sampleCount == 0)
+			continue;
 		for (int i = 0; i < mImageWidth; ++i)
+			image[(size_t)j * mImageWidth + i] = mPublishedColorData[(size_t)j * mImageWidth + i] / (float)sampleCount;
+	}
+}
+
+bool RaytracerMT::renderTile(int tileIndex, int sampleCount, bool firstPass)
+{
+	const Tile& tile = mScheduler.Tiles()[tileIndex];
+	glm::vec3* pixels = mFramebuffer.TileData(tileIndex);
+	int tileWidth = tile.x1 - tile.x0;
+
+	for (int j = tile.y1 - 1; j >= tile.y0; --j)
+	{
+		//The first pass overwrites, so the framebuffer is first touched by the thread rendering the tile
+		if (!renderRow(tile.x0, tile.x1, j, sampleCount, pixels + (j - tile.y0) * tileWidth, firstPass))
+			return false;
+	}
+	return true;
+}
+
+void RaytracerMT::workerLoop(int worker)
+{
+	TileTask task;
+	takeRayCount();
+	//Another worker may still queue a next pass, so an empty scheduler isn't the end yet, WaitNext sleeps until it is
+	while (!mJob->Cancelled() && mScheduler.WaitNext(worker, task))
+	{
+		int sampleCount = mBuildUpRender ? 1 : mSamplesPerPixel;
+		if (!renderTile(task.tile, sampleCount, task.pass == 0))
 		{
-			glm::vec3 pixelColor;
-			if (currentSample == 0)
-				pixelColor = glm::vec3(0.0f, 0.0f, 0.0f);
-			else
-				pixelColor = mOrigColorData[lineNumber * mImageWidth + i];
-			float u = (i + randomFloat()) / (mImageWidth - 1);
-			float v = (lineNumber + randomFloat()) / (mImageHeight - 1);
-			Ray r = mCamera.GetRay(u, v);
-			pixelColor += rayColor(r, mMaxDepth);
-			const std::lock_guard<std::mutex> lock(mOutputMutex);
-			writeColor(pixelColor, currentSample ? currentSample : 1, lineNumber, i);
+			//Workers waiting for this tile's next pass would sleep forever
+			mScheduler.Stop();
+			return;
 		}
+		publishTile(task.tile, mBuildUpRender ? task.pass + 1 : mSamplesPerPixel);
+
+		const Tile& tile = mScheduler.GetTile(task);
+		mJob->TileDone((int64_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * sampleCount, takeRayCount());
+		if (mScheduler.Complete(worker, task))
+			mJob->PassDone();
 	}
-	else
+}
+
+void RaytracerMT::publishTile(int tileIndex, int sampleCount)
+{
+	const Tile& tile = mScheduler.Tiles()[tileIndex];
+	std::lock_guard<std::mutex> lock(mPublishMutexes[tileIndex]);
+	std::copy_n(mFramebuffer.TileData(tileIndex), (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0), mPublished.TileData(tileIndex));
+	mTileSamples[tileIndex] = sampleCount;
+}
+
+void RaytracerMT::UpdateDisplay(const TonemapSettings& tonemap)
+{
+	//Workers keep adding to mFramebuffer while this runs, only the copies of finished passes are read
+	bool refreshAll = tonemapChanged(tonemap);
+	const std::vector<Tile>& tiles = mScheduler.Tiles();
+	for (int t = 0; t < (int)tiles.size(); ++t)
 	{
-		for (int i = 0; i < mImageWidth; ++i)
+		if (mTileSamples[t] == 0 || (mTileSamples[t] == mDisplayedTileSamples[t] && !refreshAll))
+			continue;
+
+		std::lock_guard<std::mutex> lock(mPublishMutexes[t]);
+		int sampleCount = mTileSamples[t];
+		const Tile& tile = tiles[t];
+		const glm::vec3* pixels = mPublished.TileData(t);
+		int tileWidth = tile.x1 - tile.x0;
+		for (int j = tile.y0; j < tile.y1; ++j)
+			writeDisplayRow(pixels + (j - tile.y0) * tileWidth, tileWidth, sampleCount, j, tile.x0, tonemap);
+		mDisplayedTileSamples[t] = sampleCount;
+		mDirtyRegions.Add({ tile.x0, tile.y0, tile.x1, tile.y1 });
+	}
+}
+
+void RaytracerMT::ResolveLinear(std::vector<glm::vec3>& image) const
+{
+	image.assign((size_t)mImageWidth * mImageHeight, glm::vec3(0.0f, 0.0f, 0.0f));
+	const std::vector<Tile>& tiles = mScheduler.Tiles();
+	for (int t = 0; t < (int)tiles.size(); ++t)
+	{
+		std::lock_guard<std::mutex> lock(mPublishMutexes[t]);
+		int sampleCount = mTileSamples[t];
+		if (sampleCount == 0)
+			continue;
+
+		const Tile& tile = tiles[t];
+		const glm::vec3* pixels = mPublished.TileData(t);
+		int tileWidth = tile.x1 - tile.x0;
+		for (int j = tile.y0; j < tile.y1; ++j)
 		{
-			glm::vec3 pixelColor(0.0f, 0.0f, 0.0f);
-			for (int s = 0; s < mSamplesPerPixel; ++s)
-			{
-				float u = (i + randomFloat()) / (mImageWidth - 1);
-				float v = (lineNumber + randomFloat()) / (mImageHeight - 1);
-				Ray r = mCamera.GetRay(u, v);
-				pixelColor += rayColor(r, mMaxDepth);
-			}
-			const std::lock_guard<std::mutex> lock(mOutputMutex);
-			writeColor(pixelColor, mSamplesPerPixel, lineNumber, i);
+			for (int i = tile.x0; i < tile.x1; ++i)
+				image[(size_t)j * mImageWidth + i] = pixels[(j - tile.y0) * tileWidth + (i - tile.x0)] / (float)sampleCount;
 		}
 	}
 }
 
 void RaytracerMT::Run()
 {
-	const int threadCount = std::thread::hardware_concurrency() - 2;
-	int linesPerThread = mImageHeight / threadCount;
+	//Build up renders run one pass per sample, a tile starts its next pass as soon as its worker gets back to it
+	for (size_t i = 0; i < mScheduler.Tiles().size(); i++)
+		mTileSamples[i] = 0;
+	int passCount = mBuildUpRender ? mSamplesPerPixel : 1;
+	mJob->Start((int64_t)mScheduler.Tiles().size() * passCount, passCount, (int64_t)mImageWidth * mImageHeight * mSamplesPerPixel);
+	mScheduler.Reset(passCount);
+	for (int w = 0; w < mScheduler.WorkerCount(); w++)
+		mThreadPool->Submit([this, w] { workerLoop(w); });
+	mThreadPool->Wait();
+	mJob->Finish();
+}
 
-	if (mBuildUpRender)
+size_t RaytracerStreaming::BandMemory() const
+{
+	//Radiance sums plus the converted copy handed to the writer
+	size_t bandPixels = (size_t)mImageWidth * std::min(mTileSize, mImageHeight);
+	return bandPixels * (sizeof(glm::vec3) + (mPfmOutput ? sizeof(glm::vec3) : 4));
+}
+
+void RaytracerStreaming::workerLoop(int worker, TileScheduler& scheduler, TileFramebuffer& framebuffer, int bandY0)
+{
+	//A single pass, so once nothing is left to steal the band is done
+	TileTask task;
+	takeRayCount();
+	while (!mJob->Cancelled() && scheduler.Next(worker, task))
 	{
-		for (int s = 0; s < mSamplesPerPixel; ++s)
+		const Tile& tile = scheduler.GetTile(task);
+		glm::vec3* pixels = framebuffer.TileData(task.tile);
+		int tileWidth = tile.x1 - tile.x0;
+		for (int j = tile.y1 - 1; j >= tile.y0; --j)
 		{
-			mCurrentLineNumber = mImageHeight - 1;
-			for (int i = 0; i < threadCount; i++)
-			{
-				threads.push_back(std::thread([this, s]
-					{
-						while (!cancelThreads)
-						{
-							int lineNumber = 0;
-							{
-								const std::lock_guard<std::mutex> lock(mLineMutex);
-								lineNumber = mCurrentLineNumber--;
-							}
-							this->writeLine(lineNumber, s);
-
-							if (mCurrentLineNumber == 0) return;
-						}
-					}));
-			}
+			if (!renderRow(tile.x0, tile.x1, bandY0 + j, mSamplesPerPixel, pixels + (j - tile.y0) * tileWidth, true))
+				return;
+		}
+		mJob->TileDone((int64_t)tileWidth * (tile.y1 - tile.y0) * mSamplesPerPixel, takeRayCount());
+		scheduler.Complete(worker, task);
+	}
+}
 
-			for (std::thread& t : threads) {
-				t.join();
+bool RaytracerStreaming::writeBand(const TileScheduler& scheduler, const TileFramebuffer& framebuffer, int bandHeight, PngWriter& png, PfmWriter& pfm)
+{
+	const std::vector<Tile>& tiles = scheduler.Tiles();
+	if (mPfmOutput)
+	{
+		std::vector<glm::vec3> rows((size_t)mImageWidth * bandHeight);
+		for (int t = 0; t < (int)tiles.size(); ++t)
+		{
+			const Tile& tile = tiles[t];
+			const glm::vec3* pixels = framebuffer.TileData(t);
+			int tileWidth = tile.x1 - tile.x0;
+			for (int j = tile.y0; j < tile.y1; ++j)
+			{
+				for (int i = tile.x0; i < tile.x1; ++i)
+					rows[(size_t)j * mImageWidth + i] = pixels[(j - tile.y0) * tileWidth + (i - tile.x0)] / (float)mSamplesPerPixel;
 			}
-			threads.clear();
-			std::cerr << "Sample " << s << " Done." << std::endl;
 		}
+		return pfm.WriteRows(rows.data(), bandHeight);
 	}
-	else
+
+	//PNG wants the top row first
+	std::vector<uint8_t> rows((size_t)mImageWidth * bandHeight * 4);
+	for (int t = 0; t < (int)tiles.size(); ++t)
 	{
-		mCurrentLineNumber = mImageHeight - 1;
-		for (int i = 0; i < threadCount; i++)
+		const Tile& tile = tiles[t];
+		const glm::vec3* pixels = framebuffer.TileData(t);
+		int tileWidth = tile.x1 - tile.x0;
+		for (int j = tile.y0; j < tile.y1; ++j)
+			tonemap(pixels + (j - tile.y0) * tileWidth, tileWidth, mSamplesPerPixel, mTonemap, rows.data() + ((size_t)(bandHeight - 1 - j) * mImageWidth + tile.x0) * 4);
+	}
+	return png.WriteRows(rows.data(), bandHeight);
+}
+
+void RaytracerStreaming::Run()
+{
+	int bandCount = (mImageHeight + mTileSize - 1) / mTileSize;
+	int64_t tilesPerBand = (mImageWidth + mTileSize - 1) / mTileSize;
+	mJob->Start(tilesPerBand * bandCount, 1, (int64_t)mImageWidth * mImageHeight * mSamplesPerPixel);
+	mWritten = false;
+
+	PngWriter png;
+	PfmWriter pfm;
+	bool written = mPfmOutput ? pfm.Open(mOutputPath, mImageWidth, mImageHeight) : png.Open(mOutputPath, mImageWidth, mImageHeight);
+	for (int b = 0; b < bandCount && written && !mJob->Cancelled(); b++)
+	{
+		//PFM stores the bottom row first, PNG the top one, so the bands go in file order
+		int y0, y1;
+		if (mPfmOutput)
 		{
-			threads.push_back(std::thread([this]
-				{
-					while (!cancelThreads)
-					{
-						int lineNumber = 0;
-						{
-							const std::lock_guard<std::mutex> lock(mLineMutex);
-							lineNumber = mCurrentLineNumber--;
-						}
-						this->writeLine(lineNumber, mSamplesPerPixel);
-
-						if (mCurrentLineNumber == 0) return;
-					}
-				}));
+			y0 = b * mTileSize;
+			y1 = std::min(y0 + mTileSize, mImageHeight);
 		}
-
-		for (std::thread& t : threads) {
-			t.join();
+		else
+		{
+			y1 = mImageHeight - b * mTileSize;
+			y0 = std::max(y1 - mTileSize, 0);
 		}
+
+		//Tiles of the band in band local rows, only the last band can be lower than the others
+		TileScheduler scheduler(mImageWidth, y1 - y0, mTileSize, mThreadPool->ThreadCount());
+		TileFramebuffer framebuffer(scheduler.Tiles());
+		scheduler.Reset(1);
+		for (int w = 0; w < scheduler.WorkerCount(); w++)
+			mThreadPool->Submit([this, w, &scheduler, &framebuffer, y0] { workerLoop(w, scheduler, framebuffer, y0); });
+		mThreadPool->Wait();
+		if (mJob->Cancelled())
+			break;
+
+		written = writeBand(scheduler, framebuffer, y1 - y0, png, pfm);
 	}
-}
\ No newline at end of file
+
+	//Closing a cancelled render still ends the file, it just reports it as incomplete
+	written = (mPfmOutput ? pfm.Close() : png.Close()) && written;
+	mWritten = written && !mJob->Cancelled();
+	mJob->PassDone();
+	mJob->Finish();
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <map>
@@ -7,84 +8,220 @@
 #include <thread>
 #include <chrono>
 #include <vector>
-#include "glad/glad.h"
 #include "Core/Hittable.h"
 #include "Core/Camera.h"
 #include "Material/Material.h"
+#include "Material/EnvironmentMap.h"
+#include "AccelerationStructures/LightBvh.h"
 #include "Core/RTWeekend.h"
-#include "Shader/Shader.h"
+#include "Core/RadianceCache.h"
+#include "Core/PhotonMap.h"
+#include "Core/TileScheduler.h"
+#include "Core/ThreadPool.h"
+#include "Core/Numa.h"
+#include "Core/TileFramebuffer.h"
+#include "Core/Tonemap.h"
+#include "Core/DirtyRegionTracker.h"
+#include "Core/RenderJob.h"
+#include "Core/ImageWriter.h"
+#include "Core/SceneArena.h"
+#include "Core/MemoryTracker.h"
 
 struct Scene
 {
 	HittableList world;
 	Camera camera;
 	glm::vec3 background;
+	std::shared_ptr<LightBVH> lights;
+	std::shared_ptr<EnvironmentMap> environment; //Replaces background when set
+	std::shared_ptr<SceneArena> arena; //Owns the objects in world, null if they are owned by their shared_ptrs
+};
+
+// What the previous path vertex knows about how the current ray was generated, needed to weight emitters with MIS
+struct ScatterInfo
+{
+	glm::vec3 p;
+	glm::vec3 normal;
+	float pdf;
+	bool specular;
+	bool causticPath; //Only specular vertices since the last diffuse one, the photon map covers where this ends on a light
 };
 
 class Raytracer
 {
 public:
-	Raytracer(std::shared_ptr<std::vector<GLubyte>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender)
-		: mImageTextureData(imageTextureData), mCamera(renderScene.camera), mWorld(renderScene.world), mBackground(renderScene.background), mImageHeight(imageHeight), mImageWidth(imageWidth), mSamplesPerPixel(samplesPerPixel), mMaxDepth(maxDepth), mBuildUpRender(buildUpRender), mOrigColorData(new glm::vec3[imageWidth * imageHeight])
+	Raytracer(std::shared_ptr<std::vector<uint8_t>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender, const RadianceCacheSettings& radianceCache, const PhotonMapSettings& photonMap)
+		: mImageTextureData(imageTextureData), mCamera(renderScene.camera), mWorld(renderScene.world), mBackground(renderScene.background), mLights(renderScene.lights), mEnvironment(renderScene.environment), mImageHeight(imageHeight), mImageWidth(imageWidth), mSamplesPerPixel(samplesPerPixel), mMaxDepth(maxDepth), mBuildUpRender(buildUpRender), mJob(std::make_shared<RenderJob>())
 	{
-		memset(mOrigColorData, 0, sizeof(glm::vec3) * imageHeight * imageWidth);
+		mCamera.SetImageHeight(imageHeight);
+		if (mImageTextureData)
+			mFramebufferMemory.Set(mImageTextureData->size());
+		if (radianceCache.enabled)
+			mRadianceCache = std::make_unique<RadianceCache>(radianceCache);
 	}
 	
+	virtual ~Raytracer() = default;
+
+	// Renders the whole image and returns once it is done or cancelled
 	virtual void Run() = 0;
-	virtual void Cancel() = 0;
+
+	// Asks the workers to stop, they notice within a pixel
+	void Cancel() { mJob->Cancel(); }
+
+	// Progress, cancellation and completion of the render, safe to keep and poll from other threads
+	std::shared_ptr<RenderJob> Job() const { return mJob; }
+	// Renders into a job handed out before the renderer existed, a cancel it already got stops Run right away.
+	// Must be called before Run.
+	void SetJob(std::shared_ptr<RenderJob> job) { mJob = std::move(job); }
+
+	// Tonemaps everything that got new samples since the last call into the display buffer.
+	// Meant to be called from one thread only (the UI or the code saving the image), never from inside the render.
+	virtual void UpdateDisplay(const TonemapSettings& tonemap) = 0;
+
+	// Average radiance of every pixel, rows bottom up like the display buffer
+	virtual void ResolveLinear(std::vector<glm::vec3>& image) const = 0;
+
+	// Display buffer regions UpdateDisplay rewrote, for uploading only what changed
+	DirtyRegionTracker& DirtyRegions() { return mDirtyRegions; }
 
 protected:
-	std::shared_ptr<std::vector<GLubyte>> mImageTextureData;
-	glm::vec3* mOrigColorData;
+	std::shared_ptr<std::vector<uint8_t>> mImageTextureData;
 	Camera& mCamera;
 	HittableList& mWorld;
 	glm::vec3 mBackground;
+	std::shared_ptr<LightBVH> mLights;
+	std::shared_ptr<EnvironmentMap> mEnvironment;
+	std::unique_ptr<RadianceCache> mRadianceCache; //Shared by all render threads, null when disabled
+	std::unique_ptr<PhotonMap> mPhotonMap;
 	int mImageHeight, mImageWidth, mSamplesPerPixel, mMaxDepth;
 	bool mBuildUpRender;
 
-	glm::vec3 rayColor(const Ray& r, int depth);
+	glm::vec3 rayColor(const Ray& r, int depth, const ScatterInfo* prev = nullptr);
+	// Rays the calling thread traced since it last asked
+	static int64_t takeRayCount();
+	glm::vec3 sampleLights(const Ray& r, const HitRecord& rec);
+	float environmentSelectProbability() const;
+	// Shoots the photons on the render threads, the derived constructors call it once their pool exists
+	void buildPhotonMap(const PhotonMapSettings& photonMap, ThreadPool& threadPool);
+	// Traces sampleCount samples for the pixels [x0, x1) of row j into row, false if the job got cancelled on the way
+	bool renderRow(int x0, int x1, int j, int sampleCount, glm::vec3* row, bool overwrite);
 
-	void writeColor(glm::vec3 pixelColor, int samplesPerPixel, int lineNumber, int columnNumber);
+	std::shared_ptr<RenderJob> mJob;
+	TonemapSettings mDisplayedTonemap; //Settings the display buffer was last converted with
+	DirtyRegionTracker mDirtyRegions;
+	TrackedMemory mFramebufferMemory{ MemoryCategory::Framebuffers }; //Display buffer and buffers of the raytracer itself, tile framebuffers count on their own
+
+	// True if the operator changed since the last call, the whole image has to be converted again then
+	bool tonemapChanged(const TonemapSettings& tonemap);
+	void writeDisplayRow(const glm::vec3* pixels, int count, int sampleCount, int lineNumber, int columnNumber, const TonemapSettings& tonemap);
 
 };
 
 class RaytracerNormal : public Raytracer
 {
 public:
-	RaytracerNormal(std::shared_ptr<std::vector<GLubyte>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender)
-		: Raytracer(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, buildUpRender), cancelRaytracer(false) {}
+	RaytracerNormal(std::shared_ptr<std::vector<uint8_t>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender, const RadianceCacheSettings& radianceCache = RadianceCacheSettings(), const PhotonMapSettings& photonMap = PhotonMapSettings())
+		: Raytracer(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, buildUpRender, radianceCache, photonMap), mOrigColorData(imageWidth * imageHeight, glm::vec3(0.0f, 0.0f, 0.0f)),
+		mPublishedColorData(mOrigColorData), mRowSamples(std::make_unique<std::atomic<int>[]>(imageHeight)), mDisplayedRowSamples(imageHeight, 0)
+	{
+		for (int j = 0; j < imageHeight; j++)
+			mRowSamples[j] = 0;
+		if (photonMap.enabled)
+		{
+			//Only the photon pass runs in parallel here, its threads are gone before the render starts
+			ThreadPool photonPool(TileScheduler::ResolveThreadCount(0));
+			buildPhotonMap(photonMap, photonPool);
+		}
+		mFramebufferMemory.Set(mFramebufferMemory.Bytes() + 2 * mOrigColorData.size() * sizeof(glm::vec3));
+	}
 
 	virtual void Run() override;
 
-	virtual void Cancel() override
-	{
-		cancelRaytracer = true;
-	}
+	virtual void UpdateDisplay(const TonemapSettings& tonemap) override;
+	virtual void ResolveLinear(std::vector<glm::vec3>& image) const override;
 
 private:
-	bool cancelRaytracer;
+	std::vector<glm::vec3> mOrigColorData; //Radiance sums, only touched by the render thread
+	std::vector<glm::vec3> mPublishedColorData; //Copy of every row as of its last finished pass, what the display reads
+	mutable std::mutex mPublishMutex; //Guards mPublishedColorData
+	std::unique_ptr<std::atomic<int>[]> mRowSamples; //Samples in the published copy of each row
+	std::vector<int> mDisplayedRowSamples;
+
+	void render();
+	void publishRow(int j, int sampleCount);
 };
 
 class RaytracerMT : public Raytracer
 {
 public:
 	~RaytracerMT() = default;
-	RaytracerMT(std::shared_ptr<std::vector<GLubyte>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender)
-		: Raytracer(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, buildUpRender), mCurrentLineNumber(0), cancelThreads(false) {}
+	RaytracerMT(std::shared_ptr<std::vector<uint8_t>> imageTextureData, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const bool buildUpRender, const RadianceCacheSettings& radianceCache = RadianceCacheSettings(), const PhotonMapSettings& photonMap = PhotonMapSettings(), const TileSettings& tiles = TileSettings(), std::shared_ptr<ThreadPool> threadPool = nullptr)
+		: Raytracer(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, buildUpRender, radianceCache, photonMap),
+		mThreadPool(threadPool ? threadPool : std::make_shared<ThreadPool>(TileScheduler::ResolveThreadCount(tiles.threadCount))),
+		mScheduler(imageWidth, imageHeight, tiles.tileSize, mThreadPool->ThreadCount(), tiles.order), mFramebuffer(mScheduler.Tiles(), tileAlignment()),
+		mPublished(mScheduler.Tiles(), tileAlignment()), mPublishMutexes(std::make_unique<std::mutex[]>(mScheduler.Tiles().size())), mTileSamples(std::make_unique<std::atomic<int>[]>(mScheduler.Tiles().size())), mDisplayedTileSamples(mScheduler.Tiles().size(), 0)
+	{
+		for (size_t i = 0; i < mScheduler.Tiles().size(); i++)
+			mTileSamples[i] = 0;
+		buildPhotonMap(photonMap, *mThreadPool);
+	}
 
 	virtual void Run() override;
 
-	virtual void Cancel() override
+	virtual void UpdateDisplay(const TonemapSettings& tonemap) override;
+	virtual void ResolveLinear(std::vector<glm::vec3>& image) const override;
+
+private:
+	std::shared_ptr<ThreadPool> mThreadPool; //Usually owned by the application and reused across renders
+	TileScheduler mScheduler;
+	TileFramebuffer mFramebuffer; //Written only by the worker currently holding a tile
+	TileFramebuffer mPublished; //Copy of every tile as of its last finished pass, what the display reads
+	std::unique_ptr<std::mutex[]> mPublishMutexes; //One per tile, guards its part of mPublished
+	std::unique_ptr<std::atomic<int>[]> mTileSamples; //Samples in the published copy of each tile
+	std::vector<int> mDisplayedTileSamples;
+
+	void workerLoop(int worker);
+	bool renderTile(int tileIndex, int sampleCount, bool firstPass);
+	void publishTile(int tileIndex, int sampleCount);
+	size_t tileAlignment() const { return mThreadPool->Pinned() && NumaTopology::Get().NodeCount() > 1 ? TileFramebuffer::PageSize : TileFramebuffer::CacheLineSize; }
+
+};
+
+// Renders the image band by band, one row of tiles at a time, and streams every finished band into a PNG or PFM file.
+// Nothing but the band in flight is kept, so memory grows with the image width but not with its height.
+class RaytracerStreaming : public Raytracer
+{
+public:
+	RaytracerStreaming(const std::string& outputPath, Scene& renderScene, const int imageHeight, const int imageWidth, const int samplesPerPixel, const int maxDepth, const TonemapSettings& tonemap = TonemapSettings(), const RadianceCacheSettings& radianceCache = RadianceCacheSettings(), const PhotonMapSettings& photonMap = PhotonMapSettings(), const TileSettings& tiles = TileSettings(), std::shared_ptr<ThreadPool> threadPool = nullptr)
+		: Raytracer(nullptr, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, false, radianceCache, photonMap),
+		mOutputPath(outputPath), mTonemap(tonemap), mTileSize(std::max(tiles.tileSize, 1)),
+		mPfmOutput(outputPath.size() >= 4 && outputPath.compare(outputPath.size() - 4, 4, ".pfm") == 0),
+		mThreadPool(threadPool ? threadPool : std::make_shared<ThreadPool>(TileScheduler::ResolveThreadCount(tiles.threadCount)))
 	{
-		cancelThreads = true;
+		buildPhotonMap(photonMap, *mThreadPool);
 	}
 
+	virtual void Run() override;
+
+	//There is no display buffer, finished bands only exist in the file
+	virtual void UpdateDisplay(const TonemapSettings& tonemap) override {}
+	virtual void ResolveLinear(std::vector<glm::vec3>& image) const override { image.clear(); }
+
+	// True if the last Run wrote the complete image
+	bool Written() const { return mWritten; }
+
+	// Bytes held for the band in flight, independent of the image height
+	size_t BandMemory() const;
+
 private:
-	std::mutex mOutputMutex;
-	std::mutex mLineMutex;
-	int mCurrentLineNumber;
-	std::vector<std::thread> threads;
-	std::atomic_bool cancelThreads;
-
-	void writeLine(int lineNumber, int currentSample);
-};
\ No newline at end of file
+	std::string mOutputPath;
+	TonemapSettings mTonemap;
+	int mTileSize; //Also the band height
+	bool mPfmOutput; //PNG otherwise
+	bool mWritten = false;
+	std::shared_ptr<ThreadPool> mThreadPool;
+
+	void workerLoop(int worker, TileScheduler& scheduler, TileFramebuffer& framebuffer, int bandY0);
+	bool writeBand(const TileScheduler& scheduler, const TileFramebuffer& framebuffer, int bandHeight, PngWriter& png, PfmWriter& pfm);
+
+};
@@ -0,0 +1,72 @@
+#include "Core/RenderJob.h"
+
+RenderJob::RenderJob()
+	: mTilesDone(0), mSamplesDone(0), mRaysTraced(0), mPassesDone(0), mTotalTiles(0), mTotalSamples(0), mTotalPasses(0),
+	mCancelled(false), mFinished(false), mStartTime(now()), mEndTime(-1)
+{
+}
+
+int64_t RenderJob::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RenderJob::Start(int64_t totalTiles, int totalPasses, int64_t totalSamples)
+{
+	mTilesDone = 0;
+	mSamplesDone = 0;
+	mRaysTraced = 0;
+	mPassesDone = 0;
+	mTotalTiles = totalTiles;
+	mTotalPasses = totalPasses;
+	mTotalSamples = totalSamples;
+	mEndTime = -1;
+	mFinished = false;
+	mStartTime = now();
+}
+
+void RenderJob::Finish()
+{
+	mEndTime = now();
+	{
+		const std::lock_guard<std::mutex> lock(mMutex);
+		mFinished = true;
+	}
+	mFinishedCondition.notify_all();
+
+	if (mCompletionCallback)
+		mCompletionCallback(Progress());
+}
+
+void RenderJob::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mFinishedCondition.wait(lock, [this] { return mFinished.load(); });
+}
+
+RenderProgress RenderJob::Progress() const
+{
+	RenderProgress progress;
+	progress.tilesDone = mTilesDone;
+	progress.totalTiles = mTotalTiles;
+	progress.passesDone = mPassesDone;
+	progress.totalPasses = mTotalPasses;
+	progress.samplesDone = mSamplesDone;
+	progress.totalSamples = mTotalSamples;
+	progress.raysTraced = mRaysTraced;
+	progress.finished = mFinished;
+	progress.cancelled = mCancelled;
+
+	int64_t endTime = mEndTime;
+	if (endTime < 0)
+		endTime = now();
+	progress.elapsedSeconds = (endTime - mStartTime) * 1e-9;
+
+	//Linear extrapolation over samples, the passes of a build up render all cost about the same
+	progress.etaSeconds = -1.0;
+	if (progress.finished)
+		progress.etaSeconds = 0.0;
+	else if (progress.samplesDone > 0 && progress.elapsedSeconds > 0.5)
+		progress.etaSeconds = progress.elapsedSeconds * (double)(progress.totalSamples - progress.samplesDone) / progress.samplesDone;
+	return progress;
+}
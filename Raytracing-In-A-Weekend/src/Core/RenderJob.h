@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+struct RenderProgress
+{
+	int64_t tilesDone, totalTiles;		//Tile passes, rows count as tiles for the single threaded renderer
+	int passesDone, totalPasses;		//Whole image passes, one per sample in build up renders
+	int64_t samplesDone, totalSamples;	//Camera samples over all pixels
+	int64_t raysTraced;					//Camera, bounce and shadow rays
+	double elapsedSeconds;
+	double etaSeconds;					//Negative until there is enough progress to extrapolate from
+	bool finished;
+	bool cancelled;
+
+	float Fraction() const { return totalSamples > 0 ? (float)((double)samplesDone / totalSamples) : 0.0f; }
+	double RaysPerSecond() const { return elapsedSeconds > 0.0 ? raysTraced / elapsedSeconds : 0.0; }
+};
+
+// Handle to one render: counters the workers bump, cooperative cancellation and a way to wait for the end.
+// Everything but the completion callback may be used from any thread.
+class RenderJob
+{
+public:
+	RenderJob();
+
+	// Resets the counters, called by the renderer when Run starts
+	void Start(int64_t totalTiles, int totalPasses, int64_t totalSamples);
+
+	// Marks the job as done and calls the completion callback on the thread that finished it
+	void Finish();
+
+	void Cancel() { mCancelled = true; }
+	bool Cancelled() const { return mCancelled.load(std::memory_order_relaxed); }
+	bool Finished() const { return mFinished; }
+
+	// Blocks until Finish was called
+	void Wait();
+
+	// Called once with the final progress, must be set before the render starts
+	void SetCompletionCallback(std::function<void(const RenderProgress&)> callback) { mCompletionCallback = std::move(callback); }
+
+	void TileDone(int64_t samples, int64_t rays)
+	{
+		mTilesDone.fetch_add(1, std::memory_order_relaxed);
+		mSamplesDone.fetch_add(samples, std::memory_order_relaxed);
+		mRaysTraced.fetch_add(rays, std::memory_order_relaxed);
+	}
+	void PassDone() { mPassesDone.fetch_add(1, std::memory_order_relaxed); }
+
+	RenderProgress Progress() const;
+
+private:
+	std::atomic<int64_t> mTilesDone, mSamplesDone, mRaysTraced;
+	std::atomic<int> mPassesDone;
+	std::atomic<int64_t> mTotalTiles, mTotalSamples;
+	std::atomic<int> mTotalPasses;
+	std::atomic_bool mCancelled, mFinished;
+	std::atomic<int64_t> mStartTime, mEndTime; //Steady clock nanoseconds, the end is -1 while running
+
+	static int64_t now();
+
+	std::function<void(const RenderProgress&)> mCompletionCallback;
+	std::mutex mMutex;
+	std::condition_variable mFinishedCondition;
+};
@@ -0,0 +1,63 @@
+#include <cstdint>
+#include "Core/SceneArena.h"
+
+SceneArena::~SceneArena()
+{
+	for (Destructor* record = mDestructors; record; record = record->next)
+	{
+		if (record->object)
+			record->destroy(record->object);
+	}
+	for (const Block& block : mBlocks)
+		::operator delete(block.data, std::align_val_t(BlockAlignment));
+	for (int category = 0; category < (int)MemoryCategory::Count; category++)
+		MemoryTracker::Get().Remove((MemoryCategory)category, mCategoryBytes[category]);
+}
+
+void SceneArena::reserve(size_t bytes)
+{
+	char* data = static_cast<char*>(::operator new(bytes, std::align_val_t(BlockAlignment)));
+	mBlocks.push_back({ data, bytes });
+	mReservedBytes += bytes;
+	mCategoryBytes[(int)MemoryCategory::SceneObjects] += bytes;
+	MemoryTracker::Get().Add(MemoryCategory::SceneObjects, bytes);
+}
+
+//Reserved bytes count as scene objects, objects of another category take their share over
+void SceneArena::moveBytes(MemoryCategory category, size_t bytes)
+{
+	if (category == MemoryCategory::SceneObjects)
+		return;
+	mCategoryBytes[(int)MemoryCategory::SceneObjects] -= bytes;
+	mCategoryBytes[(int)category] += bytes;
+	MemoryTracker::Get().Remove(MemoryCategory::SceneObjects, bytes);
+	MemoryTracker::Get().Add(category, bytes);
+}
+
+void* SceneArena::allocate(size_t bytes, size_t alignment, MemoryCategory category)
+{
+	mUsedBytes += bytes;
+
+	//Large objects get a block of their own, so the rest of the current block isn't wasted
+	if (bytes + alignment > BlockBytes / 4)
+	{
+		reserve(bytes + alignment);
+		moveBytes(category, bytes);
+		char* data = mBlocks.back().data;
+		return data + (alignment - reinterpret_cast<uintptr_t>(data) % alignment) % alignment;
+	}
+
+	uintptr_t cursor = reinterpret_cast<uintptr_t>(mCursor);
+	size_t padding = (alignment - cursor % alignment) % alignment;
+	if (!mCursor || padding + bytes > (size_t)(mEnd - mCursor))
+	{
+		reserve(BlockBytes);
+		mCursor = mBlocks.back().data;
+		mEnd = mCursor + BlockBytes;
+		padding = (alignment - reinterpret_cast<uintptr_t>(mCursor) % alignment) % alignment;
+	}
+	moveBytes(category, bytes);
+	char* result = mCursor + padding;
+	mCursor = result + bytes;
+	return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Core/MemoryTracker.h"
+
+// Owns the primitives and acceleration nodes of one scene in large blocks instead of one heap allocation each.
+// Objects are handed out as shared_ptrs that don't own anything, so they fit the Hittable interfaces but cost
+// no control block. Everything is destroyed at once with the arena, the scene must keep it alive as long as
+// any of its pointers are used. Building a scene is single threaded, the arena is not thread safe.
+// Blocks count as MemoryCategory::SceneObjects until objects of a type with an ArenaCategory take their bytes.
+class SceneArena
+{
+public:
+	static constexpr size_t BlockBytes = 1 << 20;
+	static constexpr size_t BlockAlignment = 64;
+
+	SceneArena() = default;
+	~SceneArena();
+	SceneArena(const SceneArena&) = delete;
+	SceneArena& operator=(const SceneArena&) = delete;
+
+	template<typename T, typename... Args>
+	std::shared_ptr<T> Make(Args&&... args)
+	{
+		MemoryCategory category = MemoryCategory::SceneObjects;
+		if constexpr (requires { T::ArenaCategory; })
+			category = T::ArenaCategory;
+
+		//Objects with a destructor get a record in front of them, the records form a list destroyed in reverse order
+		void* memory;
+		if constexpr (std::is_trivially_destructible_v<T>)
+			memory = allocate(sizeof(T), alignof(T), category);
+		else
+		{
+			size_t alignment = std::max(alignof(T), alignof(Destructor));
+			size_t headerBytes = (sizeof(Destructor) + alignment - 1) / alignment * alignment;
+			char* start = static_cast<char*>(allocate(headerBytes + sizeof(T), alignment, category));
+			memory = start + headerBytes;
+			Destructor* record = reinterpret_cast<Destructor*>(memory) - 1;
+			record->destroy = [](void* object) { static_cast<T*>(object)->~T(); };
+			record->object = nullptr; //Only set once the constructor succeeded
+			record->next = mDestructors;
+			mDestructors = record;
+		}
+		T* object = new (memory) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			(reinterpret_cast<Destructor*>(memory) - 1)->object = object;
+		mObjectCount++;
+		return std::shared_ptr<T>(std::shared_ptr<T>(), object);
+	}
+
+	size_t ObjectCount() const { return mObjectCount; }
+	// Bytes taken by objects and their destructor records
+	size_t UsedBytes() const { return mUsedBytes; }
+	// Bytes of all blocks, what the arena costs the process
+	size_t ReservedBytes() const { return mReservedBytes; }
+
+private:
+	struct Destructor
+	{
+		void (*destroy)(void*);
+		void* object;
+		Destructor* next;
+	};
+
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	std::vector<Block> mBlocks;
+	char* mCursor = nullptr;
+	char* mEnd = nullptr;
+	Destructor* mDestructors = nullptr;
+	size_t mObjectCount = 0;
+	size_t mUsedBytes = 0;
+	size_t mReservedBytes = 0;
+	size_t mCategoryBytes[(int)MemoryCategory::Count] = {}; //What the arena added to the MemoryTracker
+
+	void* allocate(size_t bytes, size_t alignment, MemoryCategory category);
+	void reserve(size_t bytes);
+	void moveBytes(MemoryCategory category, size_t bytes);
+};
@@ -0,0 +1,229 @@
+#include "Core/Scenes.h"
+#include "Core/Mesh.h"
+#include "Core/SceneArena.h"
+#include "Core/Hittable.h"
+#include "AccelerationStructures/Bvh.h"
+
+std::vector<std::string> sceneNames()
+{
+	return { "cornell-vase", "cornell", "random" };
+}
+
+bool buildScene(const std::string& name, float aspectRatio, const std::string& environmentMapPath, Scene& scene)
+{
+	std::shared_ptr<SceneArena> arena = std::make_shared<SceneArena>();
+	HittableList world;
+	glm::vec3 background = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	//Camera
+	glm::vec3 lookfrom = { 278.0f, 278.0f, -800.0f };
+	glm::vec3 lookat = { 278.0f, 278.0f, 0.0f };
+	glm::vec3 vup = { 0.0f, 1.0f, 0.0f };
+	float vfov = 40.0f;
+	float distToFocus = 10.0f;
+	float aperture = 0.0f;
+
+	if (name == "cornell-vase" || name == "cornell")
+	{
+		world = cornellBox(*arena);
+		if (name == "cornell-vase")
+		{
+			glm::mat4 vaseModelMatrix(1.0f);
+			vaseModelMatrix = glm::translate(vaseModelMatrix, { 277.5f, 100.00f, 277.5f });
+			vaseModelMatrix = glm::scale(vaseModelMatrix, { 2000.0f, 2000.0f, 2000.0f });
+			/* For Make-shift cornell box
+			vaseModelMatrix = glm::translate(vaseModelMatrix, { 0.0f, 0.02f, 0.0f });
+			vaseModelMatrix = glm::scale(vaseModelMatrix, {0.5f, 0.5f, 0.5f});
+			*/
+			world.add(arena->Make<Mesh>(vaseModelMatrix, "assets/models/brass_vase/brass_vase_04_4k.gltf"));
+
+			/*
+			auto white = std::make_shared<Lambertian>(glm::vec3(0.73f, 0.73f, 0.73f));
+
+			glm::mat4 box1Model(1.0f);
+			box1Model = glm::translate(box1Model, glm::vec3(265.0f, 0.0f, 295.0f));
+			box1Model = glm::rotate(box1Model, glm::radians(15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			world.add(std::make_shared<Box>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(165.0f, 330.0f, 165.0f), white, box1Model));
+
+			glm::mat4 box2Model(1.0f);
+			box2Model = glm::translate(box2Model, glm::vec3(130.0f, 0.0f, 65.0f));
+			box2Model = glm::rotate(box2Model, glm::radians(-18.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			world.add(std::make_shared<Box>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(165.0f, 165.0f, 165.0f), white, box2Model));
+			*/
+
+			/* Make-shift cornell box
+			auto greenMat = std::make_shared<Lambertian>(glm::vec3(0.0f, 1.0f, 0.0f));
+			auto redMat = std::make_shared<Lambertian>(glm::vec3(1.0f, 0.0f, 0.0f));
+			auto blueMat = std::make_shared<Lambertian>(glm::vec3(0.0f, 0.0f, 1.0f));
+			auto groundMaterial = std::make_shared<Lambertian>(glm::vec3(0.5f, 0.5f, 0.5f));
+			auto lightMat = std::make_shared<DiffuseLight>(glm::vec3(1.0f, 1.0f, 1.0f));
+			world.add(std::make_shared<Sphere>(glm::vec3(1.1f, 0.0f, 0.0f), 1.0f, greenMat));
+			world.add(std::make_shared<Sphere>(glm::vec3(-1.1f, 0.0f, 0.0f), 1.0f, redMat));
+			world.add(std::make_shared<Sphere>(glm::vec3(0.0f, 0.0f, 1.1f), 1.0f, blueMat));
+			world.add(std::make_shared<Sphere>(glm::vec3(0.0f, 1.3f, 0.0f), 1.1f, lightMat));
+			world.add(std::make_shared<Sphere>(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMaterial));
+			*/
+		}
+		//glm::vec3 lookfrom = { 0.0f, 0.1f, -0.5f };
+		//glm::vec3 lookat = { 0.0f, 0.1f, 0.0f };
+	}
+	else if (name == "random")
+	{
+		world = randomScene(*arena);
+		background = glm::vec3(0.70f, 0.80f, 1.00f);
+		lookfrom = { 13.0f, 2.0f, 3.0f };
+		lookat = { 0.0f, 0.0f, 0.0f };
+		vfov = 20.0f;
+		aperture = 0.1f;
+	}
+	else
+	{
+		return false;
+	}
+
+	Camera cam(lookfrom, lookat, vup, vfov, aspectRatio, aperture, distToFocus);
+
+	//One tree over all objects with bounds, meshes keep their own BVH below it
+	HittableList root;
+	std::vector<std::shared_ptr<Hittable>> bounded;
+	for (const std::shared_ptr<Hittable>& object : world.objects)
+	{
+		AABB box;
+		if (object->BoundingBox(box))
+			bounded.push_back(object);
+		else
+			root.add(object);
+	}
+	if (!bounded.empty())
+		root.add(arena->Make<BVHNode>(*arena, bounded, 0, bounded.size()));
+
+	//Lights
+	std::shared_ptr<LightBVH> lights = std::make_shared<LightBVH>(root);
+	std::shared_ptr<EnvironmentMap> environment = nullptr;
+	if (!environmentMapPath.empty())
+		environment = std::make_shared<EnvironmentMap>(environmentMapPath.c_str());
+
+	scene = { root, cam, background, lights, environment, arena };
+	return true;
+}
+
+HittableList randomScene(SceneArena& arena) {
+	HittableList world;
+
+	auto groundMaterial = std::make_shared<Lambertian>(glm::vec3(0.5f, 0.5f, 0.5f));
+	world.add(arena.Make<Sphere>(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMaterial));
+
+	for (int a = -11; a < 11; a++) {
+		for (int b = -11; b < 11; b++) {
+			auto chooseMat = randomFloat();
+			glm::vec3 center(a + 0.9f * randomFloat(), 0.2f, b + 0.9f * randomFloat());
+
+			if ((center - glm::vec3(4.0f, 0.2f, 0.0f)).length() > 0.9f) {
+				std::shared_ptr<Material> sphereMaterial;
+
+				if (chooseMat < 0.8f) {
+					// diffuse
+					auto albedo = randomVec() * randomVec();
+					sphereMaterial = std::make_shared<Lambertian>(albedo);
+					world.add(arena.Make<Sphere>(center, 0.2f, sphereMaterial));
+				}
+				else if (chooseMat < 0.95f) {
+					// metal
+					auto albedo = randomVec(0.5f, 1.0f);
+					auto fuzz = randomFloat(0.0f, 0.5f);
+					sphereMaterial = std::make_shared<Metal>(albedo, fuzz);
+					world.add(arena.Make<Sphere>(center, 0.2f, sphereMaterial));
+				}
+				else {
+					// glass
+					sphereMaterial = std::make_shared<Dielectric>(1.5f);
+					world.add(arena.Make<Sphere>(center, 0.2f, sphereMaterial));
+				}
+			}
+		}
+	}
+
+	auto material1 = std::make_shared<Dielectric>(1.5f);
+	world.add(arena.Make<Sphere>(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, material1));
+
+	auto material2 = std::make_shared<Lambertian>(glm::vec3(0.4f, 0.2f, 0.1f));
+	world.add(arena.Make<Sphere>(glm::vec3(-4.0f, 1.0f, 0.0f), 1.0f, material2));
+
+	auto material3 = std::make_shared<Metal>(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f);
+	world.add(arena.Make<Sphere>(glm::vec3(4.0f, 1.0f, 0.0f), 1.0f, material3));
+
+	return world;
+}
+
+HittableList cornellBox(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto red = std::make_shared<Lambertian>(glm::vec3(0.65f, 0.05f, 0.05f));
+	auto white = std::make_shared<Lambertian>(glm::vec3(0.73f, 0.73f, 0.73f));
+	auto green = std::make_shared<Lambertian>(glm::vec3(0.12f, 0.45f, 0.15f));
+	auto light = std::make_shared<DiffuseLight>(glm::vec3(15.0f, 15.0f, 15.0f));
+
+	Vertex vert0;
+	Vertex vert1;
+	Vertex vert2;
+	vert0.normal = { 0.0f, 0.0f, 0.0f };
+	vert1.normal = { 0.0f, 0.0f, 0.0f };
+	vert2.normal = { 0.0f, 0.0f, 0.0f };
+
+	vert0.position = glm::vec3(555.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 555.0f, 0.0f);
+	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), green, ""));
+	vert0.position = glm::vec3(555.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	vert2.position = glm::vec3(555.0f, 0.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), green, "")); //Left
+
+	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(0.0f, 555.0f, 0.0f);
+	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), red, ""));
+	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(0.0f, 555.0f, 555.0f);
+	vert2.position = glm::vec3(0.0f, 0.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), red, "")); //Right
+
+	vert0.position = glm::vec3(213.0f, 554.0f, 227.0f);
+	vert1.position = glm::vec3(343.0f, 554.0f, 227.0f);
+	vert2.position = glm::vec3(343.0f, 554.0f, 332.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), light, ""));
+	vert0.position = glm::vec3(213.0f, 554.0f, 227.0f);
+	vert1.position = glm::vec3(343.0f, 554.0f, 332.0f);
+	vert2.position = glm::vec3(213.0f, 554.0f, 332.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), light, "")); //Light
+
+	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 0.0f, 0.0f);
+	vert2.position = glm::vec3(555.0f, 0.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, ""));
+	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 0.0f, 555.0f);
+	vert2.position = glm::vec3(0.0f, 0.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "")); //Floor
+
+	vert0.position = glm::vec3(0.0f, 555.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 555.0f, 0.0f);
+	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, ""));
+	vert0.position = glm::vec3(0.0f, 555.0f, 0.0f);
+	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "")); //Top
+
+	vert0.position = glm::vec3(0.0f, 0.0f, 555.0f);
+	vert1.position = glm::vec3(555.0f, 0.0f, 555.0f);
+	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "back"));
+	vert0.position = glm::vec3(0.0f, 0.0f, 555.0f);
+	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
+	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
+	objects.add(arena.Make<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "back")); //Back
+
+	return objects;
+}
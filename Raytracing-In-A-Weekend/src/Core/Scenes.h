@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Core/Raytracer.h"
+
+// Scenes shared by the window and the headless renderer
+
+class SceneArena;
+
+// Primitives are created in the arena, which must outlive the returned lists
+HittableList randomScene(SceneArena& arena);
+HittableList cornellBox(SceneArena& arena);
+
+// Names buildScene knows, the first one is the default
+std::vector<std::string> sceneNames();
+
+// World, camera and lights of a named scene, false for unknown names. An empty environmentMapPath keeps the background.
+bool buildScene(const std::string& name, float aspectRatio, const std::string& environmentMapPath, Scene& scene);
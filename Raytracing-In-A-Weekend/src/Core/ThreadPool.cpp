@@ -0,0 +1,70 @@
+#include <algorithm>
+#include "Core/ThreadPool.h"
+#include "Core/Numa.h"
+
+ThreadPool::ThreadPool(int threadCount, bool pinThreads)
+	: mPendingJobs(0), mStopping(false), mPinned(pinThreads)
+{
+	threadCount = std::max(threadCount, 1);
+	for (int i = 0; i < threadCount; i++)
+	{
+		mWorkers.push_back(std::thread([this, i, threadCount, pinThreads]
+			{
+				if (pinThreads)
+					pinCurrentThread(NumaTopology::Get().CpuForWorker(i, threadCount));
+				workerLoop();
+			}));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mJobAvailable.notify_all();
+	for (std::thread& t : mWorkers)
+		t.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(std::move(job));
+		mPendingJobs++;
+	}
+	mJobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobsDone.wait(lock, [this] { return mPendingJobs == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAvailable.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+			if (mStopping && mJobs.empty())
+				return;
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		job();
+
+		{
+			const std::lock_guard<std::mutex> lock(mMutex);
+			mPendingJobs--;
+			if (mPendingJobs == 0)
+				mJobsDone.notify_all();
+		}
+	}
+}
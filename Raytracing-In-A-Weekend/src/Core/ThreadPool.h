@@ -0,0 +1,39 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads kept alive across renders, jobs are run in submission order
+class ThreadPool
+{
+public:
+	// With pinThreads every worker is bound to a core, see NumaTopology::CpuForWorker
+	ThreadPool(int threadCount, bool pinThreads = false);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void Submit(std::function<void()> job);
+
+	// Blocks until every submitted job has finished
+	void Wait();
+
+	int ThreadCount() const { return (int)mWorkers.size(); }
+	bool Pinned() const { return mPinned; }
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mJobsDone;
+	int mPendingJobs;
+	bool mStopping;
+	bool mPinned;
+
+	void workerLoop();
+};
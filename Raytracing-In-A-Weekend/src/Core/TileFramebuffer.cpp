@@ -0,0 +1,21 @@
+#include <new>
+#include "Core/TileFramebuffer.h"
+
+TileFramebuffer::TileFramebuffer(const std::vector<Tile>& tiles, size_t tileAlignment)
+	: mAlignment(tileAlignment), mSize(0), mData(nullptr)
+{
+	for (const Tile& tile : tiles)
+	{
+		mOffsets.push_back(mSize);
+		size_t bytes = sizeof(glm::vec3) * (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+		mSize += (bytes + mAlignment - 1) / mAlignment * mAlignment;
+	}
+
+	mData = static_cast<unsigned char*>(::operator new[](mSize > 0 ? mSize : mAlignment, std::align_val_t(mAlignment)));
+	mTrackedBytes.Set(mSize);
+}
+
+TileFramebuffer::~TileFramebuffer()
+{
+	::operator delete[](mData, std::align_val_t(mAlignment));
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "Core/RTWeekend.h"
+#include "Core/TileScheduler.h"
+#include "Core/MemoryTracker.h"
+
+// Linear radiance sums stored tile by tile. Every tile starts on its own cache line,
+// so the worker owning a tile never shares a line with another worker and needs no lock.
+// The memory is left untouched until a tile's first pass writes it, which places the pages on the NUMA node of
+// that worker. Page aligned tiles make that placement exact.
+class TileFramebuffer
+{
+public:
+	static constexpr size_t CacheLineSize = 64;
+	static constexpr size_t PageSize = 4096;
+
+	TileFramebuffer(const std::vector<Tile>& tiles, size_t tileAlignment = CacheLineSize);
+	~TileFramebuffer();
+
+	TileFramebuffer(const TileFramebuffer&) = delete;
+	TileFramebuffer& operator=(const TileFramebuffer&) = delete;
+
+	// Row major pixels of a tile, bottom row first
+	glm::vec3* TileData(int tile) { return reinterpret_cast<glm::vec3*>(mData + mOffsets[tile]); }
+	const glm::vec3* TileData(int tile) const { return reinterpret_cast<const glm::vec3*>(mData + mOffsets[tile]); }
+
+private:
+	std::vector<size_t> mOffsets; //Byte offset of every tile, a multiple of mAlignment
+	size_t mAlignment;
+	size_t mSize;
+	unsigned char* mData;
+	TrackedMemory mTrackedBytes{ MemoryCategory::Framebuffers };
+};
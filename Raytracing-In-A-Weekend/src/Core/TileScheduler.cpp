@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "Core/TileScheduler.h"
+
+TileScheduler::TileScheduler(int imageWidth, int imageHeight, int tileSize, int workerCount, TileOrder order)
+	: mPassCount(0), mRemainingTasks(0)
+{
+	tileSize = std::max(tileSize, 1);
+	workerCount = std::max(workerCount, 1);
+
+	//Top row first, the image is stored bottom up
+	int tilesX = (imageWidth + tileSize - 1) / tileSize;
+	int tilesY = (imageHeight + tileSize - 1) / tileSize;
+	uint32_t curveSize = 1;
+	while (curveSize < (uint32_t)std::max(tilesX, tilesY))
+		curveSize <<= 1;
+
+	std::vector<std::pair<uint64_t, Tile>> orderedTiles;
+	for (int ty = 0; ty < tilesY; ty++)
+	{
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			int y1 = imageHeight - ty * tileSize;
+			Tile tile = { tx * tileSize, std::max(y1 - tileSize, 0), std::min((tx + 1) * tileSize, imageWidth), y1 };
+
+			uint64_t key = (uint64_t)ty * tilesX + tx;
+			if (order == TileOrder::Morton)
+				key = mortonIndex(tx, ty);
+			else if (order == TileOrder::Hilbert)
+				key = hilbertIndex(curveSize, tx, ty);
+			else if (order == TileOrder::Spiral)
+			{
+				//Ring around the centre first, then the angle within the ring
+				float dx = tx + 0.5f - tilesX * 0.5f;
+				float dy = ty + 0.5f - tilesY * 0.5f;
+				uint64_t ring = (uint64_t)std::max(fabs(dx), fabs(dy));
+				uint64_t angle = (uint64_t)((atan2(dy, dx) + 3.14159265f) * 1000.0f);
+				key = (ring << 32) | angle;
+			}
+			orderedTiles.push_back({ key, tile });
+		}
+	}
+	std::stable_sort(orderedTiles.begin(), orderedTiles.end(), [](const std::pair<uint64_t, Tile>& a, const std::pair<uint64_t, Tile>& b) { return a.first < b.first; });
+	for (const std::pair<uint64_t, Tile>& orderedTile : orderedTiles)
+		mTiles.push_back(orderedTile.second);
+
+	for (int i = 0; i < workerCount; i++)
+		mQueues.push_back(std::make_unique<WorkerQueue>());
+}
+
+void TileScheduler::Reset(int passCount)
+{
+	for (std::unique_ptr<WorkerQueue>& queue : mQueues)
+	{
+		const std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->tasks.clear();
+	}
+
+	{
+		const std::lock_guard<std::mutex> lock(mWaitMutex);
+		mStopped = false;
+	}
+	mPassCount = passCount;
+	mRemainingTasks = passCount > 0 ? (int64_t)mTiles.size() * passCount : 0;
+	mTilesDonePerPass = std::make_unique<std::atomic<int>[]>(std::max(passCount, 1));
+	for (int i = 0; i < std::max(passCount, 1); i++)
+		mTilesDonePerPass[i] = 0;
+	if (passCount <= 0)
+		return;
+
+	//Round robin along the tile order, so the tiles in flight at any moment are neighbours
+	int workerCount = (int)mQueues.size();
+	for (int i = 0; i < (int)mTiles.size(); i++)
+	{
+		WorkerQueue& queue = *mQueues[i % workerCount];
+		const std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back({ i, 0 });
+	}
+}
+
+bool TileScheduler::Next(int worker, TileTask& task)
+{
+	{
+		WorkerQueue& own = *mQueues[worker];
+		const std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	//Steal from the far end of the other deques so the owner keeps its neighbouring tiles
+	int workerCount = (int)mQueues.size();
+	for (int i = 1; i < workerCount; i++)
+	{
+		WorkerQueue& victim = *mQueues[(worker + i) % workerCount];
+		const std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TileScheduler::Complete(int worker, const TileTask& task)
+{
+	//Only one task per tile is ever queued or running, so the next pass can't overtake this one
+	bool queued = task.pass + 1 < mPassCount;
+	if (queued)
+	{
+		WorkerQueue& own = *mQueues[worker];
+		const std::lock_guard<std::mutex> lock(own.mutex);
+		own.tasks.push_back({ task.tile, task.pass + 1 });
+	}
+
+	bool finished = --mRemainingTasks <= 0;
+	if (queued || finished)
+		notifyWaiters(finished);
+	return ++mTilesDonePerPass[task.pass] == (int)mTiles.size();
+}
+
+bool TileScheduler::WaitNext(int worker, TileTask& task)
+{
+	while (true)
+	{
+		//Read before looking at the queues, a task queued after that changes it and the wait below returns at once
+		uint64_t version = mQueueVersion.load();
+		if (Next(worker, task))
+			return true;
+
+		std::unique_lock<std::mutex> lock(mWaitMutex);
+		mWorkChanged.wait(lock, [&] { return mStopped || Finished() || mQueueVersion.load() != version; });
+		if (mStopped || Finished())
+			return false;
+	}
+}
+
+void TileScheduler::Stop()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mWaitMutex);
+		mStopped = true;
+	}
+	mWorkChanged.notify_all();
+}
+
+void TileScheduler::notifyWaiters(bool all)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mWaitMutex);
+		mQueueVersion++;
+	}
+	if (all)
+		mWorkChanged.notify_all();
+	else
+		mWorkChanged.notify_one();
+}
+
+uint32_t TileScheduler::mortonIndex(uint32_t x, uint32_t y)
+{
+	uint32_t index = 0;
+	for (int bit = 0; bit < 16; bit++)
+		index |= ((x >> bit) & 1u) << (2 * bit) | ((y >> bit) & 1u) << (2 * bit + 1);
+	return index;
+}
+
+uint32_t TileScheduler::hilbertIndex(uint32_t n, uint32_t x, uint32_t y)
+{
+	uint32_t index = 0;
+	for (uint32_t s = n / 2; s > 0; s /= 2)
+	{
+		uint32_t rx = (x & s) > 0;
+		uint32_t ry = (y & s) > 0;
+		index += s * s * ((3 * rx) ^ ry);
+
+		//Rotate the quadrant so the curve stays continuous
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return index;
+}
+
+int TileScheduler::ResolveThreadCount(int requested)
+{
+	if (requested > 0)
+		return requested;
+	int cores = (int)std::thread::hardware_concurrency();
+	return std::max(cores - 2, 1);
+}
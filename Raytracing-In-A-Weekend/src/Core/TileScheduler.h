@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Order tiles are handed out in. The curves keep the tiles rendered at the same time next to each other,
+// so the workers share BVH nodes and texels in the cache; the spiral starts in the middle for previews.
+enum class TileOrder
+{
+	Scanline,
+	Morton,
+	Hilbert,
+	Spiral
+};
+
+struct TileSettings
+{
+	int tileSize = 32;		//Tile edge in pixels
+	int threadCount = 0;	//Render threads, 0 picks one per core leaving two for the UI
+	TileOrder order = TileOrder::Hilbert;
+};
+
+// Rectangle of pixels [x0, x1) x [y0, y1)
+struct Tile
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+// One pass of one tile
+struct TileTask
+{
+	int tile;
+	int pass;
+};
+
+// Splits the image into tiles and deals them out to workers.
+// Every worker pops from the front of its own deque and steals from the back of another one once it runs dry.
+// A finished task queues the tile's next pass behind the worker's other tiles, so passes overlap without a barrier.
+class TileScheduler
+{
+public:
+	TileScheduler(int imageWidth, int imageHeight, int tileSize, int workerCount, TileOrder order = TileOrder::Scanline);
+
+	// Deals all tiles out again with passCount passes each
+	void Reset(int passCount);
+
+	// Next task for worker, false if nothing is queued right now
+	bool Next(int worker, TileTask& task);
+
+	// Next task for worker, sleeping while the only tasks left are running on other workers, which may queue
+	// their tile's next pass. False once every task is done or Stop was called.
+	bool WaitNext(int worker, TileTask& task);
+
+	// Wakes all waiting workers and makes WaitNext return false until the next Reset, for a worker giving up its task
+	void Stop();
+
+	// Marks task as done and queues the tile's next pass on worker, returns true if this was the last task of its pass
+	bool Complete(int worker, const TileTask& task);
+
+	bool Finished() const { return mRemainingTasks.load() <= 0; }
+
+	int WorkerCount() const { return (int)mQueues.size(); }
+	const std::vector<Tile>& Tiles() const { return mTiles; }
+	const Tile& GetTile(const TileTask& task) const { return mTiles[task.tile]; }
+
+	static int ResolveThreadCount(int requested);
+
+private:
+	static uint32_t mortonIndex(uint32_t x, uint32_t y);
+	static uint32_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y);
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<TileTask> tasks;
+	};
+
+	std::vector<Tile> mTiles;
+	std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+	int mPassCount;
+	std::atomic<int64_t> mRemainingTasks;
+	std::unique_ptr<std::atomic<int>[]> mTilesDonePerPass;
+
+	std::mutex mWaitMutex;
+	std::condition_variable mWorkChanged;
+	std::atomic<uint64_t> mQueueVersion{ 0 }; //Bumped under mWaitMutex whenever Complete queues a task, so a waiter can't miss it
+	bool mStopped = false; //Guarded by mWaitMutex
+
+	void notifyWaiters(bool all);
+};
@@ -0,0 +1,84 @@
+#include "Core/Tonemap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TONEMAP_SSE
+#include <emmintrin.h>
+#endif
+
+static inline float tonemapChannel(float x, TonemapOperator op)
+{
+	switch (op)
+	{
+	case TonemapOperator::Reinhard:
+		x = x / (1.0f + x);
+		break;
+	case TonemapOperator::ACES:
+		x = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+		break;
+	default:
+		break;
+	}
+	return sqrt(clamp(x, 0.0f, 0.999f));
+}
+
+#ifdef TONEMAP_SSE
+static inline __m128 tonemapChannels(__m128 x, TonemapOperator op)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	switch (op)
+	{
+	case TonemapOperator::Reinhard:
+		x = _mm_div_ps(x, _mm_add_ps(one, x));
+		break;
+	case TonemapOperator::ACES:
+	{
+		__m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), x), _mm_set1_ps(0.03f)));
+		__m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), x), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+		x = _mm_div_ps(numerator, denominator);
+		break;
+	}
+	default:
+		break;
+	}
+	x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(0.999f));
+	return _mm_sqrt_ps(x);
+}
+#endif
+
+void tonemap(const glm::vec3* pixels, int count, int sampleCount, const TonemapSettings& settings, uint8_t* rgba)
+{
+	const float scale = settings.exposure / (sampleCount > 0 ? sampleCount : 1);
+	const float* in = &pixels[0].x;
+	int i = 0;
+
+#ifdef TONEMAP_SSE
+	//Four pixels are twelve floats, mapped as three vectors and packed to bytes afterwards
+	const __m128 scaleVector = _mm_set1_ps(scale);
+	const __m128 byteScale = _mm_set1_ps(256.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		alignas(16) int32_t values[12];
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(in + i * 3 + k * 4), scaleVector);
+			_mm_store_si128(reinterpret_cast<__m128i*>(values + k * 4), _mm_cvttps_epi32(_mm_mul_ps(tonemapChannels(x, settings.op), byteScale)));
+		}
+		for (int p = 0; p < 4; p++)
+		{
+			uint8_t* out = rgba + (i + p) * 4;
+			out[0] = (uint8_t)values[p * 3];
+			out[1] = (uint8_t)values[p * 3 + 1];
+			out[2] = (uint8_t)values[p * 3 + 2];
+			out[3] = 255;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		uint8_t* out = rgba + i * 4;
+		for (int c = 0; c < 3; c++)
+			out[c] = (uint8_t)static_cast<int>(256 * tonemapChannel(in[i * 3 + c] * scale, settings.op));
+		out[3] = 255;
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include "Core/RTWeekend.h"
+
+enum class TonemapOperator
+{
+	Gamma,		//Clamp and gamma 2, what the renderer always did
+	Reinhard,
+	ACES		//Narkowicz's fit of the ACES filmic curve
+};
+
+struct TonemapSettings
+{
+	TonemapOperator op = TonemapOperator::Gamma;
+	float exposure = 1.0f;
+
+	bool operator==(const TonemapSettings& other) const { return op == other.op && exposure == other.exposure; }
+	bool operator!=(const TonemapSettings& other) const { return !(*this == other); }
+};
+
+// Converts count radiance sums of sampleCount samples each into 8-bit RGBA
+void tonemap(const glm::vec3* pixels, int count, int sampleCount, const TonemapSettings& settings, uint8_t* rgba);
@@ -0,0 +1,307 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Core/Scenes.h"
+#include "Core/ImageWriter.h"
+#include "Core/Mesh.h"
+#include "Core/MemoryTracker.h"
+#include "Material/TextureCache.h"
+
+static std::mutex monitorMutex;
+static std::condition_variable monitorCondition;
+
+// Command line renderer for machines without a display: renders one scene with RaytracerMT and writes PNG or PFM.
+// With --stream RaytracerStreaming writes the file band by band instead, for images that don't fit in memory.
+// Progress goes to stderr, the final statistics to stdout as one JSON line.
+
+struct HeadlessOptions
+{
+	int width = 1600;
+	int height = 900;
+	int samplesPerPixel = 20;
+	int maxDepth = 50;
+	std::string scene = "cornell-vase";
+	std::string output = "render.png";
+	std::string environmentMap;
+	bool stream = false;
+	bool compactMeshes = false;
+	bool hashMeshSources = false;
+	int textureBudgetMB = 0;
+	int tileCacheMB = 256;
+	TileSettings tiles;
+	TonemapSettings tonemap;
+	RadianceCacheSettings radianceCache;
+	PhotonMapSettings photonMap;
+	NumaSettings numa;
+};
+
+static void printUsage()
+{
+	std::cerr << "Usage: Raytracing-In-A-Weekend-headless [options]\n"
+		<< "  --width N          Image width (1600)\n"
+		<< "  --height N         Image height (900)\n"
+		<< "  --spp N            Samples per pixel (20)\n"
+		<< "  --depth N          Max path depth (50)\n"
+		<< "  --threads N        Render threads, 0 = one per core (0)\n"
+		<< "  --tile N           Tile size (32)\n"
+		<< "  --scene NAME       One of:";
+	for (const std::string& name : sceneNames())
+		std::cerr << " " << name;
+	std::cerr << "\n"
+		<< "  --env PATH         Environment map\n"
+		<< "  --out PATH         Output file, .png or .pfm (render.png)\n"
+		<< "  --tonemap NAME     gamma, reinhard or aces for PNG output (gamma)\n"
+		<< "  --exposure X       Exposure for PNG output (1)\n"
+		<< "  --stream           Write the image band by band instead of keeping it in memory\n"
+		<< "  --texture-budget N Texture cache budget in MB, 0 = unlimited (0)\n"
+		<< "  --tile-cache N     Cache for streamed texture pages in MB (256)\n"
+		<< "  --compact-meshes   Quantize mesh vertices to a third of their size\n"
+		<< "  --hash-meshes      Check mesh caches against the model's bytes, not just its size and time\n"
+		<< "  --radiance-cache   Enable the radiance cache\n"
+		<< "  --photons N        Enable the caustic photon map with N photons, shot from emissive triangles only\n"
+		<< "  --pin-threads      Pin workers to cores\n"
+		<< "  --interleave       Interleave scene memory over NUMA nodes" << std::endl;
+}
+
+// Quoted JSON string of text, paths may contain quotes, backslashes or control characters
+static std::string jsonString(const std::string& text)
+{
+	std::string json = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			json += '\\';
+			json += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			json += escaped;
+		}
+		else
+			json += c;
+	}
+	return json + "\"";
+}
+
+// Current and peak bytes of every tracked subsystem as a JSON object
+static std::string memoryJson()
+{
+	std::ostringstream json;
+	json << "{";
+	for (int category = 0; category < (int)MemoryCategory::Count; category++)
+	{
+		MemoryUsage usage = MemoryTracker::Get().Usage((MemoryCategory)category);
+		json << "\"" << MemoryTracker::Name((MemoryCategory)category) << "\":{\"current\":" << usage.currentBytes << ",\"peak\":" << usage.peakBytes << "},";
+	}
+	MemoryUsage total = MemoryTracker::Get().Total();
+	json << "\"total\":{\"current\":" << total.currentBytes << ",\"peak\":" << total.peakBytes << "}}";
+	return json.str();
+}
+
+static bool parseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--radiance-cache")
+			options.radianceCache.enabled = true;
+		else if (arg == "--stream")
+			options.stream = true;
+		else if (arg == "--compact-meshes")
+			options.compactMeshes = true;
+		else if (arg == "--hash-meshes")
+			options.hashMeshSources = true;
+		else if (arg == "--pin-threads")
+			options.numa.pinThreads = true;
+		else if (arg == "--interleave")
+			options.numa.interleaveSceneMemory = true;
+		else if (arg == "--help" || arg == "-h")
+			return false;
+		else if (!hasValue)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		else
+		{
+			std::string value = argv[++i];
+			if (arg == "--width")
+				options.width = std::atoi(value.c_str());
+			else if (arg == "--height")
+				options.height = std::atoi(value.c_str());
+			else if (arg == "--spp")
+				options.samplesPerPixel = std::atoi(value.c_str());
+			else if (arg == "--depth")
+				options.maxDepth = std::atoi(value.c_str());
+			else if (arg == "--threads")
+				options.tiles.threadCount = std::atoi(value.c_str());
+			else if (arg == "--tile")
+				options.tiles.tileSize = std::atoi(value.c_str());
+			else if (arg == "--scene")
+				options.scene = value;
+			else if (arg == "--env")
+				options.environmentMap = value;
+			else if (arg == "--out")
+				options.output = value;
+			else if (arg == "--texture-budget")
+				options.textureBudgetMB = std::atoi(value.c_str());
+			else if (arg == "--tile-cache")
+				options.tileCacheMB = std::atoi(value.c_str());
+			else if (arg == "--exposure")
+				options.tonemap.exposure = (float)std::atof(value.c_str());
+			else if (arg == "--photons")
+			{
+				options.photonMap.enabled = true;
+				options.photonMap.photonCount = std::atoi(value.c_str());
+			}
+			else if (arg == "--tonemap")
+			{
+				if (value == "gamma")
+					options.tonemap.op = TonemapOperator::Gamma;
+				else if (value == "reinhard")
+					options.tonemap.op = TonemapOperator::Reinhard;
+				else if (value == "aces")
+					options.tonemap.op = TonemapOperator::ACES;
+				else
+				{
+					std::cerr << "Unknown tonemap operator " << value << std::endl;
+					return false;
+				}
+			}
+			else
+			{
+				std::cerr << "Unknown option " << arg << std::endl;
+				return false;
+			}
+		}
+	}
+
+	if (options.width < 2 || options.height < 2 || options.samplesPerPixel < 1 || options.maxDepth < 1)
+	{
+		std::cerr << "Width and height must be at least 2, spp and depth at least 1" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return 2;
+	}
+
+	//TileScheduler::ResolveThreadCount leaves cores for the window, there is none here
+	if (options.tiles.threadCount <= 0)
+		options.tiles.threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	auto loadStart = std::chrono::steady_clock::now();
+	std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(options.tiles.threadCount, options.numa.pinThreads);
+
+	TextureCache::Get().SetBudget((size_t)std::max(options.textureBudgetMB, 0) * 1024 * 1024);
+	TextureTileCache::Get().SetCapacity((size_t)std::max(options.tileCacheMB, 1) * 1024 * 1024);
+	Mesh::SetVertexFormat(options.compactMeshes ? MeshVertexFormat::Compact : MeshVertexFormat::Full);
+	MeshCache::SetContentHashing(options.hashMeshSources);
+
+	Scene scene;
+	std::unique_ptr<Raytracer> raytracer;
+	RaytracerStreaming* streaming = nullptr;
+	std::shared_ptr<std::vector<uint8_t>> imageData;
+	{
+		ScopedMemoryInterleave interleave(options.numa.interleaveSceneMemory);
+		if (!buildScene(options.scene, (float)options.width / options.height, options.environmentMap, scene))
+		{
+			std::cerr << "Unknown scene " << options.scene << std::endl;
+			printUsage();
+			return 2;
+		}
+		if (options.stream)
+		{
+			auto streamingRaytracer = std::make_unique<RaytracerStreaming>(options.output, scene, options.height, options.width, options.samplesPerPixel, options.maxDepth,
+				options.tonemap, options.radianceCache, options.photonMap, options.tiles, pool);
+			streaming = streamingRaytracer.get();
+			raytracer = std::move(streamingRaytracer);
+		}
+		else
+		{
+			imageData = std::make_shared<std::vector<uint8_t>>((size_t)options.width * options.height * 4);
+			raytracer = std::make_unique<RaytracerMT>(imageData, scene, options.height, options.width, options.samplesPerPixel, options.maxDepth, false,
+				options.radianceCache, options.photonMap, options.tiles, pool);
+		}
+	}
+	double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+	//Progress to stderr every few seconds while the main thread renders
+	std::shared_ptr<RenderJob> job = raytracer->Job();
+	std::thread monitor([job]
+		{
+			std::unique_lock<std::mutex> lock(monitorMutex);
+			while (!monitorCondition.wait_for(lock, std::chrono::seconds(2), [&job] { return job->Finished(); }))
+			{
+				RenderProgress current = job->Progress();
+				std::cerr << (int)(current.Fraction() * 100.0f) << "%, " << current.RaysPerSecond() * 1e-6 << " Mrays/s";
+				if (current.etaSeconds > 0.0)
+					std::cerr << ", " << (int)current.etaSeconds << "s left";
+				std::cerr << std::endl;
+			}
+		});
+	job->SetCompletionCallback([](const RenderProgress&)
+		{
+			const std::lock_guard<std::mutex> lock(monitorMutex);
+			monitorCondition.notify_all();
+		});
+
+	TextureTileCache::Get().ResetStats();
+	raytracer->Run();
+	monitor.join();
+	RenderProgress progress = job->Progress();
+
+	bool written;
+	if (streaming)
+		written = streaming->Written();
+	else if (endsWith(options.output, ".pfm"))
+	{
+		std::vector<glm::vec3> linear;
+		raytracer->ResolveLinear(linear);
+		written = writePFM(options.output, options.width, options.height, linear.data());
+	}
+	else
+	{
+		raytracer->UpdateDisplay(options.tonemap);
+		written = writePNG(options.output, options.width, options.height, imageData->data());
+	}
+	if (!written)
+		std::cerr << "Could not write " << options.output << std::endl;
+
+	TextureCacheStats textureStats = TextureCache::Get().Stats();
+	TileCacheStats tileStats = TextureTileCache::Get().Stats();
+	std::cout << "{\"scene\":" << jsonString(options.scene) << ",\"width\":" << options.width << ",\"height\":" << options.height
+		<< ",\"spp\":" << options.samplesPerPixel << ",\"depth\":" << options.maxDepth << ",\"threads\":" << pool->ThreadCount()
+		<< ",\"load_seconds\":" << loadSeconds << ",\"render_seconds\":" << progress.elapsedSeconds
+		<< ",\"rays\":" << progress.raysTraced
+		<< ",\"scene_objects\":" << scene.arena->ObjectCount() << ",\"scene_arena_bytes\":" << scene.arena->ReservedBytes()
+		<< ",\"textures\":" << textureStats.entries << ",\"texture_bytes\":" << textureStats.residentBytes
+		<< ",\"texture_hits\":" << textureStats.hits << ",\"texture_misses\":" << textureStats.misses
+		<< ",\"tile_cache_hit_rate\":" << tileStats.HitRate() << ",\"texture_io_bytes\":" << tileStats.bytesRead << ",\"rays_per_second\":" << progress.RaysPerSecond()
+		<< ",\"memory\":" << memoryJson() << ",\"streamed\":" << (streaming ? "true" : "false") << ",\"output\":" << jsonString(options.output) << ",\"written\":" << (written ? "true" : "false") << "}" << std::endl;
+
+	return written ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include "Material/EnvironmentMap.h"
+#include "Material/TextureCache.h"
+
+EnvironmentMap::EnvironmentMap(const char* path, float intensity)
+    : texture(TextureCache::Get().Load(path)), intensity(intensity), totalWeight(0.0f)
+{
+    if (!texture->Valid())
+    {
+        std::cout << "Could not load environment map at location: " << path << std::endl;
+        return;
+    }
+
+    const int width = texture->Width();
+    const int height = texture->Height();
+
+    //Rows near the poles cover less solid angle, weight by sin(theta)
+    std::vector<float> columnWeights(width);
+    rowWeights.resize(height);
+    conditional.reserve(height);
+    for (int y = 0; y < height; y++)
+    {
+        float sinTheta = sin(pi * (y + 0.5f) / height);
+        float rowSum = 0.0f;
+        for (int x = 0; x < width; x++)
+        {
+            columnWeights[x] = luminance(texture->Texel(x, y)) * sinTheta;
+            rowSum += columnWeights[x];
+        }
+        conditional.emplace_back(columnWeights);
+        rowWeights[y] = rowSum;
+        totalWeight += rowSum;
+    }
+
+    if (totalWeight > 0.0f)
+        marginal = AliasTable(rowWeights);
+}
+
+void EnvironmentMap::directionToTexel(const glm::vec3& direction, int& x, int& y, float& sinTheta) const
+{
+    glm::vec3 d = glm::normalize(direction);
+    float theta = acos(clamp(d.y, -1.0f, 1.0f));
+    float phi = atan2(d.z, d.x) + pi;
+    sinTheta = sin(theta);
+
+    x = (int)(phi / (2.0f * pi) * texture->Width());
+    y = (int)(theta / pi * texture->Height());
+    x = x < 0 ? 0 : (x >= texture->Width() ? texture->Width() - 1 : x);
+    y = y < 0 ? 0 : (y >= texture->Height() ? texture->Height() - 1 : y);
+}
+
+glm::vec3 EnvironmentMap::Lookup(const glm::vec3& direction) const
+{
+    int x, y;
+    float sinTheta;
+    directionToTexel(direction, x, y, sinTheta);
+    return intensity * texture->Texel(x, y);
+}
+
+bool EnvironmentMap::Sample(glm::vec3& direction, glm::vec3& radiance, float& pdf) const
+{
+    if (!Valid())
+        return false;
+
+    int y = marginal.Sample(randomFloat());
+    int x = conditional[y].Sample(randomFloat());
+
+    float theta = pi * (y + randomFloat()) / texture->Height();
+    float phi = 2.0f * pi * (x + randomFloat()) / texture->Width() - pi;
+    float sinTheta = sin(theta);
+    if (sinTheta <= 0.0f)
+        return false;
+
+    direction = glm::vec3(sinTheta * cos(phi), cos(theta), sinTheta * sin(phi));
+    radiance = intensity * texture->Texel(x, y);
+
+    //Density over the unit square is weight / total * width * height, the Jacobian to solid angle is 2 * pi^2 * sin(theta)
+    float weight = marginal.Pmf(y) * conditional[y].Pmf(x);
+    pdf = weight * texture->Width() * texture->Height() / (2.0f * pi * pi * sinTheta);
+    return pdf > 0.0f;
+}
+
+float EnvironmentMap::Pdf(const glm::vec3& direction) const
+{
+    if (!Valid())
+        return 0.0f;
+
+    int x, y;
+    float sinTheta;
+    directionToTexel(direction, x, y, sinTheta);
+    if (sinTheta <= 0.0f)
+        return 0.0f;
+
+    float weight = marginal.Pmf(y) * conditional[y].Pmf(x);
+    return weight * texture->Width() * texture->Height() / (2.0f * pi * pi * sinTheta);
+}
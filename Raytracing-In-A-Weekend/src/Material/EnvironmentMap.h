@@ -0,0 +1,31 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Core/RTWeekend.h"
+#include "Core/AliasTable.h"
+#include "Material/Texture.h"
+
+// Equirectangular HDR environment, importance sampled by a piecewise-constant 2D distribution over its texels
+class EnvironmentMap
+{
+public:
+    EnvironmentMap(const char* path, float intensity = 1.0f);
+
+    bool Valid() const { return texture && texture->Valid() && marginal.Size() > 0; }
+
+    glm::vec3 Lookup(const glm::vec3& direction) const;
+
+    // Picks a direction proportional to radiance * sin(theta), pdf is with respect to solid angle
+    bool Sample(glm::vec3& direction, glm::vec3& radiance, float& pdf) const;
+    float Pdf(const glm::vec3& direction) const;
+
+private:
+    std::shared_ptr<Texture> texture;
+    float intensity;
+    AliasTable marginal; //Picks a row
+    std::vector<AliasTable> conditional; //Picks a column within a row
+    std::vector<float> rowWeights;
+    float totalWeight;
+
+    void directionToTexel(const glm::vec3& direction, int& x, int& y, float& sinTheta) const;
+};
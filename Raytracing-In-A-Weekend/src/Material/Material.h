@@ -1,6 +1,7 @@
 #pragma once
 #include "Core/RTWeekend.h"
 #include "Material/Texture.h"
+#include "Material/Microfacet.h"
 
 struct HitRecord;
 
@@ -9,9 +10,26 @@ class Material
 public:
     virtual bool scatter(const Ray& rIn, const HitRecord& rec, glm::vec3& attenuation, Ray& scattered) const = 0;
 
-    virtual glm::vec3 emitted(float u, float v, const glm::vec3& p) const {
+    virtual glm::vec3 emitted(const Ray& rIn, const HitRecord& rec, float u, float v, const glm::vec3& p) const {
         return glm::vec3(0.0f, 0.0f, 0.0f);
     }
+
+    // brdf * cos(theta) towards direction, used when the direction comes from light sampling
+    virtual glm::vec3 evaluate(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const {
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    // Solid angle pdf of scatter() producing direction
+    virtual float scatteringPdf(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const {
+        return 0.0f;
+    }
+
+    // Delta distributions (mirrors, glass) can't be sampled from the light side
+    virtual bool isSpecular(const HitRecord& rec) const { return true; }
+    // View independent scattering, the outgoing radiance can be cached per position
+    virtual bool isDiffuse(const HitRecord& rec) const { return false; }
+    virtual bool isEmissive() const { return false; }
+    virtual bool isTwoSided() const { return true; }
 };
 
 class Lambertian : public Material
@@ -35,6 +53,25 @@ public:
         return true;
     }
 
+    virtual glm::vec3 evaluate(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        float cosine = dot(rec.normal, glm::normalize(direction));
+        return cosine > 0.0f ? albedo * cosine / pi : glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    virtual float scatteringPdf(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        float cosine = dot(rec.normal, glm::normalize(direction));
+        #ifdef HEMISPHERE_DIFFUSE
+        return cosine > 0.0f ? 1.0f / (2.0f * pi) : 0.0f;
+        #else
+        return cosine > 0.0f ? cosine / pi : 0.0f;
+        #endif
+    }
+
+    virtual bool isSpecular(const HitRecord& rec) const override { return false; }
+    virtual bool isDiffuse(const HitRecord& rec) const override { return true; }
+
 private:
     glm::vec3 albedo;
 };
@@ -42,16 +79,39 @@ private:
 class Metal : public Material
 {
 public:
+    // fuzz is used as GGX roughness, 0 is a perfect mirror
     Metal(const glm::vec3& a, float f) : albedo(a), fuzz(f < 1 ? f : 1) {}
 
     virtual bool scatter(const Ray& rIn, const HitRecord& rec, glm::vec3& attenuation, Ray& scattered) const override
     {
-        glm::vec3 reflected = reflect(glm::normalize(rIn.direction), rec.normal);
-        scattered = Ray(rec.p, reflected + fuzz*randomVecInUnitSphere());
-        attenuation = albedo;
-        return (dot(scattered.direction, rec.normal) > 0);
+        glm::vec3 wo = -glm::normalize(rIn.direction);
+        float alpha = fuzz * fuzz;
+        if (alpha < ggxSpecularAlpha)
+        {
+            scattered = Ray(rec.p, reflect(-wo, rec.normal));
+            attenuation = schlickFresnel(albedo, dot(wo, rec.normal));
+            return (dot(scattered.direction, rec.normal) > 0);
+        }
+
+        glm::vec3 wi;
+        if (!ggxSample(wo, rec.normal, alpha, albedo, wi, attenuation))
+            return false;
+        scattered = Ray(rec.p, wi);
+        return true;
+    }
+
+    virtual glm::vec3 evaluate(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        return ggxEvaluate(-glm::normalize(rIn.direction), glm::normalize(direction), rec.normal, fuzz * fuzz, albedo);
+    }
+
+    virtual float scatteringPdf(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        return ggxPdf(-glm::normalize(rIn.direction), glm::normalize(direction), rec.normal, fuzz * fuzz);
     }
 
+    virtual bool isSpecular(const HitRecord& rec) const override { return fuzz * fuzz < ggxSpecularAlpha; }
+
 private:
     glm::vec3 albedo;
     float fuzz;
@@ -105,10 +165,12 @@ public:
         return false;
     }
 
-    virtual glm::vec3 emitted(float u, float v, const glm::vec3& p) const override {
+    virtual glm::vec3 emitted(const Ray& rIn, const HitRecord& rec, float u, float v, const glm::vec3& p) const override {
         return emit;
     }
 
+    virtual bool isEmissive() const override { return emit.x > 0.0f || emit.y > 0.0f || emit.z > 0.0f; }
+
 public:
     glm::vec3 emit;
 };
@@ -116,7 +178,7 @@ public:
 class PBRMaterial : public Material
 {
 public:
-    PBRMaterial(std::shared_ptr<Texture> diffuse) : diffuseTexture(diffuse) {}
+    PBRMaterial(std::shared_ptr<Texture> diffuse) : diffuseTexture(diffuse), baseColor(1.0f, 1.0f, 1.0f), emissiveFactor(0.0f, 0.0f, 0.0f), twoSided(false) {}
 
     virtual bool scatter(const Ray& rIn, const HitRecord& rec, glm::vec3& attenuation, Ray& scattered) const override
     {
@@ -130,7 +192,7 @@ public:
             glm::vec3 N = glm::normalize(rec.normal);
             glm::mat3 TBN(T, B, N);
 
-            normal = normalTexture->At(rec.u, rec.v) * 2.0f - 1.0f;
+            normal = normalTexture->Sample(rec.u, rec.v, rec.textureFootprint) * 2.0f - 1.0f;
             normal = glm::normalize(TBN * normal);
         }
         else
@@ -139,13 +201,29 @@ public:
         }
         normal = rec.normal; //Normalmapping doesn't work properly yet
 
-        attenuation = diffuseTexture->At(rec.u, rec.v);
+        attenuation = albedo(rec);
 
         if (roughnessTexture)
         {
-            glm::vec3 reflected = reflect(glm::normalize(rIn.direction), normal);
-            scattered = Ray(rec.p, reflected + roughnessTexture->At(rec.u, rec.v) * randomVecInUnitSphere());
-            return (dot(scattered.direction, normal) > 0);
+            //Conductor with the base color as reflectance at normal incidence
+            glm::vec3 wo = -glm::normalize(rIn.direction);
+            if (dot(normal, wo) < 0.0f)
+                normal = -normal;
+
+            float alpha = roughnessAlpha(rec);
+            if (alpha < ggxSpecularAlpha)
+            {
+                scattered = Ray(rec.p, reflect(-wo, normal));
+                attenuation = schlickFresnel(attenuation, dot(wo, normal));
+                return (dot(scattered.direction, normal) > 0);
+            }
+
+            glm::vec3 wi;
+            glm::vec3 f0 = attenuation;
+            if (!ggxSample(wo, normal, alpha, f0, wi, attenuation))
+                return false;
+            scattered = Ray(rec.p, wi);
+            return true;
         }
         else
         {
@@ -159,12 +237,73 @@ public:
         }
     }
 
+    virtual glm::vec3 emitted(const Ray& rIn, const HitRecord& rec, float u, float v, const glm::vec3& p) const override
+    {
+        if (!twoSided && !rec.frontFace)
+            return glm::vec3(0.0f, 0.0f, 0.0f);
+        if (emissiveTexture)
+            return emissiveFactor * emissiveTexture->Sample(u, v, rec.textureFootprint);
+        return emissiveFactor;
+    }
+
+    virtual glm::vec3 evaluate(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        if (roughnessTexture)
+        {
+            glm::vec3 wo = -glm::normalize(rIn.direction);
+            glm::vec3 normal = dot(rec.normal, wo) < 0.0f ? -rec.normal : rec.normal;
+            return ggxEvaluate(wo, glm::normalize(direction), normal, roughnessAlpha(rec), albedo(rec));
+        }
+
+        float cosine = dot(rec.normal, glm::normalize(direction));
+        return cosine > 0.0f ? albedo(rec) * cosine / pi : glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    virtual float scatteringPdf(const Ray& rIn, const HitRecord& rec, const glm::vec3& direction) const override
+    {
+        if (roughnessTexture)
+        {
+            glm::vec3 wo = -glm::normalize(rIn.direction);
+            glm::vec3 normal = dot(rec.normal, wo) < 0.0f ? -rec.normal : rec.normal;
+            return ggxPdf(wo, glm::normalize(direction), normal, roughnessAlpha(rec));
+        }
+
+        float cosine = dot(rec.normal, glm::normalize(direction));
+        return cosine > 0.0f ? cosine / pi : 0.0f;
+    }
+
+    virtual bool isSpecular(const HitRecord& rec) const override { return roughnessTexture && roughnessAlpha(rec) < ggxSpecularAlpha; }
+    virtual bool isDiffuse(const HitRecord& rec) const override { return !roughnessTexture; }
+    virtual bool isEmissive() const override { return emissiveFactor.x > 0.0f || emissiveFactor.y > 0.0f || emissiveFactor.z > 0.0f; }
+    virtual bool isTwoSided() const override { return twoSided; }
+
+    void setDiffuseTexture(std::shared_ptr<Texture> diffuse) { diffuseTexture = diffuse; }
     void setRoughnessTexture(std::shared_ptr<Texture> rough) { roughnessTexture = rough; }
     void setNormalTexture(std::shared_ptr<Texture> normal) {normalTexture = normal; }
+    void setBaseColor(const glm::vec3& color) { baseColor = color; }
+    void setEmissive(const glm::vec3& factor, std::shared_ptr<Texture> texture) { emissiveFactor = factor; emissiveTexture = texture; }
+    void setEmissiveTexture(std::shared_ptr<Texture> texture) { emissiveTexture = texture; }
+    void setTwoSided(bool sided) { twoSided = sided; }
 
 private:
     std::shared_ptr<Texture> diffuseTexture;
     std::shared_ptr<Texture> roughnessTexture;
     std::shared_ptr<Texture> normalTexture;
+    std::shared_ptr<Texture> emissiveTexture;
+    glm::vec3 baseColor;
+    glm::vec3 emissiveFactor;
+    bool twoSided;
+
+    glm::vec3 albedo(const HitRecord& rec) const
+    {
+        return diffuseTexture ? diffuseTexture->Sample(rec.u, rec.v, rec.textureFootprint) : baseColor;
+    }
+
+    //glTF packs roughness into the green channel, grayscale maps have it everywhere
+    float roughnessAlpha(const HitRecord& rec) const
+    {
+        float roughness = roughnessTexture->Sample(rec.u, rec.v, rec.textureFootprint).y;
+        return roughness * roughness;
+    }
 
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+#include "Core/RTWeekend.h"
+
+// GGX / Trowbridge-Reitz microfacet reflection with visible normal sampling (Heitz 2018).
+// Directions are in world space and point away from the surface, alpha is roughness squared.
+
+// Below this alpha the lobe is treated as a perfect mirror
+const float ggxSpecularAlpha = 1e-3f;
+
+inline void buildOrthonormalBasis(const glm::vec3& n, glm::vec3& t, glm::vec3& b)
+{
+    float sign = copysignf(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float c = n.x * n.y * a;
+    t = glm::vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = glm::vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+inline glm::vec3 toLocal(const glm::vec3& v, const glm::vec3& t, const glm::vec3& b, const glm::vec3& n)
+{
+    return glm::vec3(glm::dot(v, t), glm::dot(v, b), glm::dot(v, n));
+}
+
+inline glm::vec3 schlickFresnel(const glm::vec3& f0, float cosTheta)
+{
+    float m = clamp(1.0f - cosTheta, 0.0f, 1.0f);
+    float m2 = m * m;
+    return f0 + (glm::vec3(1.0f, 1.0f, 1.0f) - f0) * (m2 * m2 * m);
+}
+
+inline float ggxD(const glm::vec3& wm, float alpha)
+{
+    float cos2Theta = wm.z * wm.z;
+    if (cos2Theta <= 0.0f)
+        return 0.0f;
+    float tan2Theta = (1.0f - cos2Theta) / cos2Theta;
+    float e = 1.0f + tan2Theta / (alpha * alpha);
+    return 1.0f / (pi * alpha * alpha * cos2Theta * cos2Theta * e * e);
+}
+
+inline float ggxLambda(const glm::vec3& w, float alpha)
+{
+    float cos2Theta = w.z * w.z;
+    if (cos2Theta <= 0.0f)
+        return infinity;
+    float tan2Theta = (1.0f - cos2Theta) / cos2Theta;
+    return (sqrt(1.0f + alpha * alpha * tan2Theta) - 1.0f) * 0.5f;
+}
+
+inline float ggxG1(const glm::vec3& w, float alpha)
+{
+    return 1.0f / (1.0f + ggxLambda(w, alpha));
+}
+
+inline float ggxG2(const glm::vec3& wo, const glm::vec3& wi, float alpha)
+{
+    return 1.0f / (1.0f + ggxLambda(wo, alpha) + ggxLambda(wi, alpha));
+}
+
+// Samples a microfacet normal from the distribution of normals visible from wo (local space)
+inline glm::vec3 ggxSampleVisibleNormal(const glm::vec3& wo, float alpha, float u1, float u2)
+{
+    glm::vec3 vh = glm::normalize(glm::vec3(alpha * wo.x, alpha * wo.y, wo.z));
+    float lensq = vh.x * vh.x + vh.y * vh.y;
+    glm::vec3 t1 = lensq > 0.0f ? glm::vec3(-vh.y, vh.x, 0.0f) / sqrt(lensq) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 t2 = glm::cross(vh, t1);
+
+    float r = sqrt(u1);
+    float phi = 2.0f * pi * u2;
+    float p1 = r * cos(phi);
+    float p2 = r * sin(phi);
+    float s = 0.5f * (1.0f + vh.z);
+    p2 = (1.0f - s) * sqrt(1.0f - p1 * p1) + s * p2;
+
+    glm::vec3 nh = p1 * t1 + p2 * t2 + sqrt(fmax(0.0f, 1.0f - p1 * p1 - p2 * p2)) * vh;
+    return glm::normalize(glm::vec3(alpha * nh.x, alpha * nh.y, fmax(1e-6f, nh.z)));
+}
+
+// Solid angle pdf of sampling wi from wo through a visible normal (local space)
+inline float ggxPdfLocal(const glm::vec3& wo, const glm::vec3& wi, float alpha)
+{
+    if (wo.z <= 0.0f || wi.z <= 0.0f)
+        return 0.0f;
+    glm::vec3 wm = glm::normalize(wo + wi);
+    float woDotWm = glm::dot(wo, wm);
+    if (woDotWm <= 0.0f)
+        return 0.0f;
+    float visibleD = ggxG1(wo, alpha) * woDotWm * ggxD(wm, alpha) / wo.z;
+    return visibleD / (4.0f * woDotWm);
+}
+
+// Samples wi for the conductor lobe around n. weight is brdf * cos / pdf = F * G2 / G1
+inline bool ggxSample(const glm::vec3& wo, const glm::vec3& n, float alpha, const glm::vec3& f0, glm::vec3& wi, glm::vec3& weight)
+{
+    glm::vec3 t, b;
+    buildOrthonormalBasis(n, t, b);
+    glm::vec3 woLocal = toLocal(wo, t, b, n);
+    if (woLocal.z <= 0.0f)
+        return false;
+
+    glm::vec3 wm = ggxSampleVisibleNormal(woLocal, alpha, randomFloat(), randomFloat());
+    glm::vec3 wiLocal = glm::reflect(-woLocal, wm);
+    if (wiLocal.z <= 0.0f)
+        return false;
+
+    wi = wiLocal.x * t + wiLocal.y * b + wiLocal.z * n;
+    weight = schlickFresnel(f0, glm::dot(woLocal, wm)) * (ggxG2(woLocal, wiLocal, alpha) / ggxG1(woLocal, alpha));
+    return true;
+}
+
+// brdf * cos(theta_i) of the conductor lobe
+inline glm::vec3 ggxEvaluate(const glm::vec3& wo, const glm::vec3& wi, const glm::vec3& n, float alpha, const glm::vec3& f0)
+{
+    glm::vec3 t, b;
+    buildOrthonormalBasis(n, t, b);
+    glm::vec3 woLocal = toLocal(wo, t, b, n);
+    glm::vec3 wiLocal = toLocal(wi, t, b, n);
+    if (woLocal.z <= 0.0f || wiLocal.z <= 0.0f)
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+
+    glm::vec3 wm = glm::normalize(woLocal + wiLocal);
+    float d = ggxD(wm, alpha);
+    float g = ggxG2(woLocal, wiLocal, alpha);
+    return schlickFresnel(f0, glm::dot(woLocal, wm)) * (d * g / (4.0f * woLocal.z));
+}
+
+inline float ggxPdf(const glm::vec3& wo, const glm::vec3& wi, const glm::vec3& n, float alpha)
+{
+    glm::vec3 t, b;
+    buildOrthonormalBasis(n, t, b);
+    return ggxPdfLocal(toLocal(wo, t, b, n), toLocal(wi, t, b, n), alpha);
+}
\ No newline at end of file
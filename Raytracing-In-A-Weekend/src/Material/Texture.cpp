@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Material/Texture.h"
+
+static float srgbDecode(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float Texture::srgbToLinear[256];
+bool Texture::srgbTableReady = Texture::initSrgbTable();
+
+bool Texture::initSrgbTable()
+{
+	for (int i = 0; i < 256; i++)
+		srgbToLinear[i] = srgbDecode(i / 255.0f);
+	return true;
+}
+
+float Texture::halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		//Denormal, shift the mantissa up until it's normalized
+		exponent = 113;
+		while ((mantissa & 0x400) == 0)
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint16_t Texture::floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xFF) - 112;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	if (exponent <= 0)
+	{
+		//Denormals keep what's left of the mantissa, anything smaller flushes to zero
+		if (exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		return sign | (uint16_t)((mantissa >> (14 - exponent)) + ((mantissa >> (13 - exponent)) & 1));
+	}
+	if (exponent >= 0x1F)
+		return sign | 0x7C00;
+	//Round to nearest, a carry into the exponent is still the right value
+	return sign | (uint16_t)(((exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+size_t Texture::bytesPerTexel(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::R8: return 1;
+	case TextureFormat::RGB8: return 3;
+	case TextureFormat::RGB8Srgb: return 3;
+	case TextureFormat::R16F: return 2;
+	case TextureFormat::RGB16F: return 6;
+	default: return 12;
+	}
+}
+
+void Texture::encode(uint8_t* texel, const glm::vec3& value) const
+{
+	auto unorm8 = [](float v) { return (uint8_t)(clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	switch (format)
+	{
+	case TextureFormat::R8:
+		texel[0] = unorm8(value.x);
+		break;
+	case TextureFormat::RGB8:
+		for (int c = 0; c < 3; c++)
+			texel[c] = unorm8(value[c]);
+		break;
+	case TextureFormat::RGB8Srgb:
+		for (int c = 0; c < 3; c++)
+		{
+			float v = clamp(value[c], 0.0f, 1.0f);
+			texel[c] = unorm8(v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f);
+		}
+		break;
+	case TextureFormat::R16F:
+		*reinterpret_cast<uint16_t*>(texel) = floatToHalf(value.x);
+		break;
+	case TextureFormat::RGB16F:
+		for (int c = 0; c < 3; c++)
+			reinterpret_cast<uint16_t*>(texel)[c] = floatToHalf(value[c]);
+		break;
+	default:
+		*reinterpret_cast<glm::vec3*>(texel) = value;
+		break;
+	}
+}
+
+void Texture::buildLevels(const uint8_t* packed)
+{
+	//Every level padded to whole pages, down to a single texel
+	size_t texelCount = 0;
+	int width = textureWidth, height = textureHeight;
+	while (true)
+	{
+		int pagesX = (width + PageSize - 1) / PageSize;
+		int pagesY = (height + PageSize - 1) / PageSize;
+		levels.push_back({ width, height, pagesX, pagesY, texelCount });
+		texelCount += (size_t)pagesX * pagesY * PageTexels;
+		if (width == 1 && height == 1)
+			break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	texelBytes = bytesPerTexel(format);
+	textureData.assign(texelCount * texelBytes, 0);
+	auto texel = [this](const MipLevel& level, int x, int y) { return textureData.data() + (pageIndex(level, x, y) * PageTexels + texelInPage(x % PageSize, y % PageSize)) * texelBytes; };
+	for (int y = 0; y < textureHeight; y++)
+	{
+		for (int x = 0; x < textureWidth; x++)
+			memcpy(texel(levels[0], x, y), packed + ((size_t)y * textureWidth + x) * texelBytes, texelBytes);
+	}
+
+	//Box filtered in linear space. With odd sizes a texel's box covers a fraction more than two source texels,
+	//the ones at its ends are weighted by how much of them it covers, which keeps the average brightness.
+	auto boxWeight = [](int target, int sourceSize, int targetSize, int sourceTexel)
+	{
+		float begin = (float)target * sourceSize / targetSize;
+		float end = (float)(target + 1) * sourceSize / targetSize;
+		return std::max(std::min(end, sourceTexel + 1.0f) - std::max(begin, (float)sourceTexel), 0.0f);
+	};
+	for (size_t l = 1; l < levels.size(); l++)
+	{
+		const MipLevel& source = levels[l - 1];
+		const MipLevel& level = levels[l];
+		for (int y = 0; y < level.height; y++)
+		{
+			int y0 = y * source.height / level.height;
+			int y1 = ((y + 1) * source.height + level.height - 1) / level.height;
+			for (int x = 0; x < level.width; x++)
+			{
+				int x0 = x * source.width / level.width;
+				int x1 = ((x + 1) * source.width + level.width - 1) / level.width;
+				glm::vec3 sum(0.0f, 0.0f, 0.0f);
+				float weightSum = 0.0f;
+				for (int sy = y0; sy < y1; sy++)
+				{
+					float weightY = boxWeight(y, source.height, level.height, sy);
+					for (int sx = x0; sx < x1; sx++)
+					{
+						float weight = weightY * boxWeight(x, source.width, level.width, sx);
+						sum += weight * decode(texel(source, sx, sy));
+						weightSum += weight;
+					}
+				}
+				encode(texel(level, x, y), sum / weightSum);
+			}
+		}
+	}
+}
+
+Texture::Texture(const char* path, TextureUsage usage)
+	: textureWidth(-1), textureHeight(-1), format(TextureFormat::RGB8), texelBytes(3)
+{
+	tiledFile = TiledTextureFile::Open(path);
+	if (tiledFile)
+	{
+		//The file only vouches for its own layout, lookups also rely on the page size and texel size compiled in here
+		const TiledTextureHeader& header = tiledFile->Header();
+		if (header.pageSize != PageSize || header.format > (uint32_t)TextureFormat::RGB32F || header.texelBytes != bytesPerTexel((TextureFormat)header.format))
+		{
+			std::cout << "Invalid tiled texture " << path << std::endl;
+			tiledFile.reset();
+			return;
+		}
+		format = (TextureFormat)header.format;
+		texelBytes = header.texelBytes;
+		textureWidth = header.width;
+		textureHeight = header.height;
+		levels = tiledFile->Levels();
+		return;
+	}
+
+	//Decoded into packed rows first, buildLevels tiles them and adds the mip chain
+	std::vector<uint8_t> packed;
+	//Always asks for three channels, stb replicates grayscale sources so the green channel is the value
+	int nrChannels;
+	bool singleChannel = usage == TextureUsage::Roughness;
+	if (stbi_is_hdr(path))
+	{
+		float* data = stbi_loadf(path, &textureWidth, &textureHeight, &nrChannels, 3);
+		if (data)
+		{
+			format = TextureFormat::RGB32F;
+			packed.resize((size_t)textureWidth * textureHeight * sizeof(glm::vec3));
+			memcpy(packed.data(), data, packed.size());
+		}
+		stbi_image_free(data);
+	}
+	else if (stbi_is_16_bit(path))
+	{
+		stbi_us* data = stbi_load_16(path, &textureWidth, &textureHeight, &nrChannels, 3);
+		if (data)
+		{
+			format = singleChannel ? TextureFormat::R16F : TextureFormat::RGB16F;
+			size_t texelCount = (size_t)textureWidth * textureHeight;
+			int channels = singleChannel ? 1 : 3;
+			packed.resize(texelCount * channels * sizeof(uint16_t));
+			uint16_t* texels = reinterpret_cast<uint16_t*>(packed.data());
+			for (size_t i = 0; i < texelCount; i++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					float value = data[i * 3 + (singleChannel ? 1 : c)] / 65535.0f;
+					texels[i * channels + c] = floatToHalf(usage == TextureUsage::Color ? srgbDecode(value) : value);
+				}
+			}
+		}
+		stbi_image_free(data);
+	}
+	else
+	{
+		stbi_uc* data = stbi_load(path, &textureWidth, &textureHeight, &nrChannels, 3);
+		if (data)
+		{
+			size_t texelCount = (size_t)textureWidth * textureHeight;
+			if (singleChannel)
+			{
+				format = TextureFormat::R8;
+				packed.resize(texelCount);
+				for (size_t i = 0; i < texelCount; i++)
+					packed[i] = data[i * 3 + 1];
+			}
+			else
+			{
+				format = usage == TextureUsage::Color ? TextureFormat::RGB8Srgb : TextureFormat::RGB8;
+				packed.assign(data, data + texelCount * 3);
+			}
+		}
+		stbi_image_free(data);
+	}
+
+	if (!packed.empty())
+	{
+		TrackedMemory decodeMemory(MemoryCategory::ImportTemporaries, packed.size());
+		buildLevels(packed.data());
+		trackedBytes.Set(textureData.size());
+	}
+	else
+		std::cout << "Failed to load texture" << std::endl;
+}
+
+std::string Texture::TiledPath(const std::string& source, TextureUsage usage)
+{
+	const char* usageNames[] = { "color", "linear", "roughness" };
+	return source + "." + usageNames[(int)usage] + ".rtx";
+}
+
+bool Texture::WriteTiled(const std::string& path, const std::string& source) const
+{
+	if (!Valid() || tiledFile)
+		return false;
+
+	TiledTextureHeader header;
+	if (!TiledTextureFile::SourceStamp(source, header.sourceSize, header.sourceTime))
+		return false;
+	memcpy(header.magic, "RTTX", 4);
+	header.version = TiledTextureFile::Version;
+	header.format = (uint32_t)format;
+	header.levelCount = (uint32_t)levels.size();
+	header.width = textureWidth;
+	header.height = textureHeight;
+	header.pageSize = PageSize;
+	header.texelBytes = (uint32_t)texelBytes;
+	//Pages start on a 4K boundary so every page read stays aligned to the page cache
+	size_t tableEnd = sizeof(TiledTextureHeader) + sizeof(TiledTextureLevel) * levels.size();
+	header.dataOffset = (tableEnd + 4095) & ~(uint64_t)4095;
+	return TiledTextureFile::Write(path, header, levels, textureData.data(), textureData.size());
+}
@@ -1,48 +1,207 @@
 #pragma once
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Core/RTWeekend.h"
+#include "Core/MemoryTracker.h"
+#include "Material/TextureTileCache.h"
 #include "stb_image.h"
 
+// What a texture holds, decides how 8 and 16-bit sources are decoded and how many channels are kept
+enum class TextureUsage
+{
+	Color,		//sRGB encoded albedo or emission
+	Linear,		//Data maps like normals, stored values map linearly to [0, 1]
+	Roughness	//Only the green channel is kept, glTF packs roughness there and grayscale maps have it everywhere
+};
+
+// How the texels are stored. 8-bit sources stay 8-bit, 16-bit sources become half floats after
+// linearization, full floats are kept only for HDR files.
+enum class TextureFormat
+{
+	R8,
+	RGB8,
+	RGB8Srgb,	//Decoded through a lookup table at fetch time
+	R16F,
+	RGB16F,
+	RGB32F
+};
+
+// Mip mapped texture. Every level is stored in pages of 64x64 texels made of 8x8 tiles with the texels of a tile
+// in Morton order, so a filtered lookup touches one or two cache lines instead of rows far apart.
+// Textures converted to the tiled file format stay on disk and their pages come through the TextureTileCache.
 class Texture
 {
 public:
-	Texture(const char* path)
-		: textureData(nullptr), textureWidth(-1), textureHeight(-1)
+	static constexpr int TileSize = 8;
+	static constexpr int PageSize = 64;
+	static constexpr int PageTexels = PageSize * PageSize;
+
+	// Decodes an image file or opens a tiled texture file, whose pages are then read on demand
+	Texture(const char* path, TextureUsage usage = TextureUsage::Color);
+
+	// Writes the decoded texture as a tiled texture file, stamped with the size and time of the source it was decoded from
+	bool WriteTiled(const std::string& path, const std::string& source) const;
+
+	// Where the converter puts the tiled version of an image for the given usage, next to the source
+	static std::string TiledPath(const std::string& source, TextureUsage usage);
+
+	// Nearest texel of the finest level, u and v wrap around
+	glm::vec3 At(float uCoord, float vCoord) const
 	{
-		int nrChannels;
-		float* data = stbi_loadf(path, &textureWidth, &textureHeight, &nrChannels, 0);
-		if (data)
-		{
-			unsigned int dataSize = textureWidth * textureHeight;
-			textureData = new glm::vec3[dataSize];
-			unsigned int j = 0;
-			for (unsigned int i = 0; i < dataSize; i++)
-			{
-				textureData[i].x = data[j++];
-				textureData[i].y = data[j++];
-				textureData[i].z = data[j++];
-			}
-		}
-		else
-		{
-			std::cout << "Failed to load texture" << std::endl;
-		}
-		stbi_image_free(data);
+		int texelX = (int)floor(uCoord * textureWidth) % textureWidth;
+		int texelY = (int)floor((1 - vCoord) * textureHeight) % textureHeight;
+		if (texelX < 0)
+			texelX += textureWidth;
+		if (texelY < 0)
+			texelY += textureHeight;
+
+		return Texel(texelX, texelY);
 	}
 
-	~Texture()
+	// Trilinear lookup. footprint is the width of the ray cone on the surface in uv units,
+	// 0 falls back to bilinear filtering of the finest level.
+	glm::vec3 Sample(float uCoord, float vCoord, float footprint) const
 	{
-		if(textureData)
-			delete[] textureData;
+		float lod = footprint > 0.0f ? log2f(footprint * (float)std::max(textureWidth, textureHeight)) : 0.0f;
+		if (lod <= 0.0f)
+			return bilinear(0, uCoord, vCoord);
+		int lastLevel = (int)levels.size() - 1;
+		if (lod >= lastLevel)
+			return bilinear(lastLevel, uCoord, vCoord);
+
+		int level = (int)lod;
+		float blend = lod - level;
+		return (1.0f - blend) * bilinear(level, uCoord, vCoord) + blend * bilinear(level + 1, uCoord, vCoord);
 	}
 
-	glm::vec3& At(float uCoord, float vCoord)
+	// Raw texel access, y = 0 is the first row in the file
+	glm::vec3 Texel(int x, int y, int level = 0) const
 	{
-		int texelX = (uCoord * textureWidth) - 0.5f;
-		int texelY = ((1-vCoord) * textureHeight) - 0.5f;
-
-		return textureData[texelY * textureHeight + texelX];
+		PageRef page;
+		return fetch(levels[level], x, y, page);
 	}
 
+	bool Valid() const { return !levels.empty(); }
+	bool Streamed() const { return tiledFile != nullptr; }
+	// False for a streamed texture whose source image was edited after the conversion
+	bool MatchesSource(const std::string& source) const { return !tiledFile || tiledFile->MatchesSource(source); }
+	int Width() const { return textureWidth; }
+	int Height() const { return textureHeight; }
+	int LevelCount() const { return (int)levels.size(); }
+	TextureFormat Format() const { return format; }
+	// Texel memory held by the texture itself, streamed pages are accounted for by the tile cache
+	size_t Bytes() const { return textureData.size(); }
+
+	static float halfToFloat(uint16_t half);
+	static uint16_t floatToHalf(float value);
+
 private:
-	glm::vec3* textureData;
+	typedef TiledTextureLevel MipLevel;
+
+	// Page the last fetch went to, the texels of a bilinear lookup mostly share one
+	struct PageRef
+	{
+		uint64_t page = UINT64_MAX;
+		TextureTileCache::Page data;
+	};
+
+	std::vector<uint8_t> textureData;
+	std::vector<MipLevel> levels;
+	std::shared_ptr<TiledTextureFile> tiledFile;
 	int textureWidth, textureHeight;
-};
\ No newline at end of file
+	TextureFormat format;
+	size_t texelBytes;
+	TrackedMemory trackedBytes{ MemoryCategory::Textures };
+
+	static float srgbToLinear[256];
+	static bool srgbTableReady;
+	static bool initSrgbTable();
+
+	static uint64_t pageIndex(const MipLevel& level, int x, int y)
+	{
+		return level.firstTexel / PageTexels + (uint64_t)(y / PageSize) * level.pagesX + x / PageSize;
+	}
+
+	static size_t texelInPage(int x, int y)
+	{
+		//Bits of the in-tile coordinates interleaved, x in the even bits
+		static const uint8_t spreadBits[TileSize] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+		size_t tile = (size_t)(y / TileSize) * (PageSize / TileSize) + x / TileSize;
+		return tile * TileSize * TileSize + (spreadBits[x % TileSize] | (spreadBits[y % TileSize] << 1));
+	}
+
+	glm::vec3 fetch(const MipLevel& level, int x, int y, PageRef& ref) const
+	{
+		uint64_t page = pageIndex(level, x, y);
+		size_t inPage = texelInPage(x % PageSize, y % PageSize);
+		if (!tiledFile)
+			return decode(textureData.data() + (page * PageTexels + inPage) * texelBytes);
+
+		if (page != ref.page)
+		{
+			ref.data = TextureTileCache::Get().Fetch(*tiledFile, page);
+			ref.page = page;
+		}
+		return decode(ref.data->data() + inPage * texelBytes);
+	}
+
+	glm::vec3 bilinear(int levelIndex, float uCoord, float vCoord) const
+	{
+		const MipLevel& level = levels[levelIndex];
+		float x = uCoord * level.width - 0.5f;
+		float y = (1 - vCoord) * level.height - 0.5f;
+		float xFloor = floor(x);
+		float yFloor = floor(y);
+		float fx = x - xFloor;
+		float fy = y - yFloor;
+
+		int x0 = (int)xFloor % level.width;
+		int y0 = (int)yFloor % level.height;
+		if (x0 < 0)
+			x0 += level.width;
+		if (y0 < 0)
+			y0 += level.height;
+		int x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+		int y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+
+		PageRef page;
+		glm::vec3 top = (1.0f - fx) * fetch(level, x0, y0, page) + fx * fetch(level, x1, y0, page);
+		glm::vec3 bottom = (1.0f - fx) * fetch(level, x0, y1, page) + fx * fetch(level, x1, y1, page);
+		return (1.0f - fy) * top + fy * bottom;
+	}
+
+	glm::vec3 decode(const uint8_t* texel) const
+	{
+		switch (format)
+		{
+		case TextureFormat::R8:
+		{
+			float value = texel[0] * (1.0f / 255.0f);
+			return glm::vec3(value, value, value);
+		}
+		case TextureFormat::RGB8:
+			return glm::vec3(texel[0], texel[1], texel[2]) * (1.0f / 255.0f);
+		case TextureFormat::RGB8Srgb:
+			return glm::vec3(srgbToLinear[texel[0]], srgbToLinear[texel[1]], srgbToLinear[texel[2]]);
+		case TextureFormat::R16F:
+		{
+			float value = halfToFloat(*reinterpret_cast<const uint16_t*>(texel));
+			return glm::vec3(value, value, value);
+		}
+		case TextureFormat::RGB16F:
+		{
+			const uint16_t* halves = reinterpret_cast<const uint16_t*>(texel);
+			return glm::vec3(halfToFloat(halves[0]), halfToFloat(halves[1]), halfToFloat(halves[2]));
+		}
+		default:
+			return *reinterpret_cast<const glm::vec3*>(texel);
+		}
+	}
+
+	void encode(uint8_t* texel, const glm::vec3& value) const;
+	static size_t bytesPerTexel(TextureFormat format);
+	void buildLevels(const uint8_t* packed);
+};
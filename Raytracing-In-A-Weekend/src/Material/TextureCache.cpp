@@ -0,0 +1,109 @@
+#include <filesystem>
+#include <iostream>
+#include "Material/TextureCache.h"
+
+TextureCache& TextureCache::Get()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+std::string TextureCache::canonicalPath(const std::string& path)
+{
+    //Different spellings of the same file ("a/../b.png", "./b.png") end up on one entry
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return error ? path : canonical.string();
+}
+
+std::shared_future<std::shared_ptr<Texture>> TextureCache::LoadAsync(const std::string& path, TextureUsage usage)
+{
+    //The same file loaded for another usage is stored differently, so it is a separate entry
+    std::string canonical = canonicalPath(path);
+    std::string key = canonical + '|' + std::to_string((int)usage);
+
+    const std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    if (it != mEntries.end())
+    {
+        mStats.hits++;
+        mLru.splice(mLru.begin(), mLru, it->second.lruPosition);
+        return it->second.texture;
+    }
+
+    mStats.misses++;
+    mLru.push_front(key);
+    Entry& entry = mEntries[key];
+    entry.lruPosition = mLru.begin();
+    entry.texture = std::async(std::launch::async, [this, key, canonical, usage]
+        {
+            //A converted tiled file next to the source is streamed instead of decoding the source, unless it was rejected
+            //or the source was edited after the conversion
+            std::string tiledPath = Texture::TiledPath(canonical, usage);
+            std::error_code error;
+            std::shared_ptr<Texture> texture;
+            if (std::filesystem::exists(tiledPath, error))
+            {
+                texture = std::make_shared<Texture>(tiledPath.c_str(), usage);
+                if (texture->Valid() && !texture->MatchesSource(canonical))
+                    std::cout << tiledPath << " is older than its source, decoding the source instead" << std::endl;
+            }
+            if (!texture || !texture->Valid() || !texture->MatchesSource(canonical))
+                texture = std::make_shared<Texture>(canonical.c_str(), usage);
+            loaded(key, texture->Bytes());
+            return texture;
+        }).share();
+    return entry.texture;
+}
+
+void TextureCache::loaded(const std::string& key, size_t bytes)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+        return;
+    it->second.bytes = bytes;
+    mStats.residentBytes += bytes;
+    if (mStats.budgetBytes > 0)
+        evict(mStats.budgetBytes);
+}
+
+void TextureCache::evict(size_t targetBytes)
+{
+    //Oldest first, skipping textures that are still decoding or held by a material
+    for (auto key = mLru.end(); key != mLru.begin() && mStats.residentBytes > targetBytes;)
+    {
+        --key;
+        auto it = mEntries.find(*key);
+        const Entry& entry = it->second;
+        if (entry.bytes == 0 || entry.texture.wait_for(std::chrono::seconds(0)) != std::future_status::ready || entry.texture.get().use_count() > 1)
+            continue;
+
+        mStats.residentBytes -= entry.bytes;
+        mStats.evictions++;
+        mEntries.erase(it);
+        key = mLru.erase(key);
+    }
+}
+
+void TextureCache::SetBudget(size_t bytes)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mStats.budgetBytes = bytes;
+    if (bytes > 0)
+        evict(bytes);
+}
+
+void TextureCache::Trim()
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    evict(0);
+}
+
+TextureCacheStats TextureCache::Stats() const
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    TextureCacheStats stats = mStats;
+    stats.entries = mEntries.size();
+    return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Material/Texture.h"
+
+struct TextureCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t residentBytes = 0; //Decoded texels of every cached texture
+    size_t budgetBytes = 0;   //0 means unlimited
+    size_t entries = 0;
+};
+
+// Process wide texture cache, keyed by canonical path and usage so every file is decoded once no matter how many
+// meshes or materials reference it. Once the resident size goes over the budget, the least recently
+// requested textures nobody holds anymore are dropped. Textures still in use are never evicted, so the
+// budget can be exceeded by the working set.
+class TextureCache
+{
+public:
+    static TextureCache& Get();
+
+    // Texture for path, decoding it on a separate thread on a miss. Requests for a file that is
+    // still decoding share that decode.
+    std::shared_future<std::shared_ptr<Texture>> LoadAsync(const std::string& path, TextureUsage usage = TextureUsage::Color);
+    std::shared_ptr<Texture> Load(const std::string& path, TextureUsage usage = TextureUsage::Color) { return LoadAsync(path, usage).get(); }
+
+    void SetBudget(size_t bytes);
+    TextureCacheStats Stats() const;
+
+    // Drops every texture nobody holds
+    void Trim();
+
+private:
+    TextureCache() = default;
+
+    struct Entry
+    {
+        std::shared_future<std::shared_ptr<Texture>> texture;
+        size_t bytes = 0; //0 until the decode finished
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, Entry> mEntries;
+    std::list<std::string> mLru; //Most recently requested first
+    TextureCacheStats mStats;
+
+    void loaded(const std::string& key, size_t bytes);
+    void evict(size_t targetBytes);
+    static std::string canonicalPath(const std::string& path);
+};
@@ -0,0 +1,230 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "Material/TextureTileCache.h"
+#include "Core/MemoryTracker.h"
+
+static std::atomic<uint64_t> nextFileId(1);
+
+TiledTextureFile::~TiledTextureFile()
+{
+#ifndef _WIN32
+    if (mFile >= 0)
+        close(mFile);
+#endif
+}
+
+std::shared_ptr<TiledTextureFile> TiledTextureFile::Open(const std::string& path)
+{
+    std::shared_ptr<TiledTextureFile> file(new TiledTextureFile());
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream || !stream.read((char*)&file->mHeader, sizeof(TiledTextureHeader)))
+        return nullptr;
+
+    const TiledTextureHeader& header = file->mHeader;
+    if (memcmp(header.magic, "RTTX", 4) != 0 || header.version != Version || header.levelCount == 0 || header.levelCount > 32)
+        return nullptr;
+    file->mLevels.resize(header.levelCount);
+    if (!stream.read((char*)file->mLevels.data(), sizeof(TiledTextureLevel) * header.levelCount))
+        return nullptr;
+    stream.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)stream.tellg();
+    stream.close();
+    if (!validLayout(file->mHeader, file->mLevels, fileSize))
+        return nullptr;
+
+#ifdef _WIN32
+    file->mFile.open(path, std::ios::binary);
+    if (!file->mFile)
+        return nullptr;
+#else
+    file->mFile = open(path.c_str(), O_RDONLY);
+    if (file->mFile < 0)
+        return nullptr;
+#endif
+    file->mId = nextFileId++;
+    return file;
+}
+
+bool TiledTextureFile::validLayout(const TiledTextureHeader& header, const std::vector<TiledTextureLevel>& levels, uint64_t fileSize)
+{
+    //Everything a lookup derives an offset from has to stay inside the file, a corrupt or foreign file is rejected
+    if (header.pageSize == 0 || header.pageSize > 4096 || header.texelBytes == 0 || header.texelBytes > 16)
+        return false;
+    uint64_t tableEnd = sizeof(TiledTextureHeader) + sizeof(TiledTextureLevel) * levels.size();
+    if (header.dataOffset < tableEnd || header.dataOffset > fileSize)
+        return false;
+    if (header.width != levels[0].width || header.height != levels[0].height)
+        return false;
+
+    uint64_t pageTexels = (uint64_t)header.pageSize * header.pageSize;
+    uint64_t pageBytes = pageTexels * header.texelBytes;
+    uint64_t dataPages = (fileSize - header.dataOffset) / pageBytes;
+    for (const TiledTextureLevel& level : levels)
+    {
+        if (level.width <= 0 || level.height <= 0)
+            return false;
+        if (level.pagesX != (int32_t)((level.width + header.pageSize - 1) / header.pageSize) || level.pagesY != (int32_t)((level.height + header.pageSize - 1) / header.pageSize))
+            return false;
+        if (level.firstTexel % pageTexels != 0)
+            return false;
+        uint64_t levelPages = (uint64_t)level.pagesX * level.pagesY;
+        uint64_t firstPage = level.firstTexel / pageTexels;
+        if (levelPages > dataPages || firstPage > dataPages - levelPages)
+            return false;
+    }
+    return true;
+}
+
+bool TiledTextureFile::Write(const std::string& path, const TiledTextureHeader& header, const std::vector<TiledTextureLevel>& levels, const uint8_t* data, size_t size)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    file.write((const char*)&header, sizeof(TiledTextureHeader));
+    file.write((const char*)levels.data(), sizeof(TiledTextureLevel) * levels.size());
+    std::vector<char> padding(header.dataOffset - sizeof(TiledTextureHeader) - sizeof(TiledTextureLevel) * levels.size(), 0);
+    file.write(padding.data(), padding.size());
+    file.write((const char*)data, size);
+    return (bool)file;
+}
+
+bool TiledTextureFile::SourceStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+    time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    return !error;
+}
+
+bool TiledTextureFile::MatchesSource(const std::string& source) const
+{
+    uint64_t size;
+    int64_t time;
+    if (!SourceStamp(source, size, time))
+        return true;
+    return size == mHeader.sourceSize && time == mHeader.sourceTime;
+}
+
+bool TiledTextureFile::ReadPage(uint64_t page, uint8_t* out) const
+{
+    size_t size = PageBytes();
+    uint64_t offset = mHeader.dataOffset + page * size;
+#ifdef _WIN32
+    const std::lock_guard<std::mutex> lock(mFileMutex);
+    mFile.clear();
+    mFile.seekg(offset);
+    return (bool)mFile.read((char*)out, size);
+#else
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t count = pread(mFile, out + done, size - done, offset + done);
+        if (count <= 0)
+            return false;
+        done += count;
+    }
+    return true;
+#endif
+}
+
+TextureTileCache& TextureTileCache::Get()
+{
+    static TextureTileCache cache;
+    return cache;
+}
+
+TextureTileCache::Page TextureTileCache::Fetch(const TiledTextureFile& file, uint64_t page)
+{
+    //Page numbers stay far below 2^40, the file id goes above them
+    uint64_t key = (file.Id() << 40) | page;
+    Shard& shard = mShards[(key * 0x9E3779B97F4A7C15ull) >> 58];
+    {
+        const std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.pages.find(key);
+        if (it != shard.pages.end())
+        {
+            shard.hits++;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+        shard.misses++;
+    }
+
+    //Read without holding the shard, another thread may load the same page meanwhile and win the insert
+    auto data = std::make_shared<std::vector<uint8_t>>(file.PageBytes(), 0);
+    bool read = file.ReadPage(page, data->data());
+
+    const std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!read)
+    {
+        //Failed pages come back black and aren't kept, so a later fetch tries again
+        shard.readErrors++;
+        return data;
+    }
+    shard.bytesRead += data->size();
+    auto it = shard.pages.find(key);
+    if (it != shard.pages.end())
+        return it->second->second;
+
+    shard.lru.push_front({ key, data });
+    shard.pages[key] = shard.lru.begin();
+    shard.bytes += data->size();
+    MemoryTracker::Get().Add(MemoryCategory::Textures, data->size());
+    trim(shard, mCapacity.load() / ShardCount);
+    return data;
+}
+
+void TextureTileCache::trim(Shard& shard, size_t capacity)
+{
+    //Keeps the newest page even if it alone is over the shard's share
+    while (shard.bytes > capacity && shard.lru.size() > 1)
+    {
+        shard.bytes -= shard.lru.back().second->size();
+        MemoryTracker::Get().Remove(MemoryCategory::Textures, shard.lru.back().second->size());
+        shard.pages.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+}
+
+void TextureTileCache::SetCapacity(size_t bytes)
+{
+    mCapacity = bytes;
+    for (Shard& shard : mShards)
+    {
+        const std::lock_guard<std::mutex> lock(shard.mutex);
+        trim(shard, bytes / ShardCount);
+    }
+}
+
+TileCacheStats TextureTileCache::Stats() const
+{
+    TileCacheStats stats;
+    stats.capacityBytes = mCapacity.load();
+    for (Shard& shard : mShards)
+    {
+        const std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.bytesRead += shard.bytesRead;
+        stats.readErrors += shard.readErrors;
+        stats.residentBytes += shard.bytes;
+    }
+    return stats;
+}
+
+void TextureTileCache::ResetStats()
+{
+    for (Shard& shard : mShards)
+    {
+        const std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.hits = shard.misses = shard.bytesRead = shard.readErrors = 0;
+    }
+}
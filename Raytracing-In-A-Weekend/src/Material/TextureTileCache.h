@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// On-disk layout of a tiled texture: the header, one entry per mip level, then the pages from dataOffset on.
+// A page is PageSize x PageSize texels of one level, stored exactly like Texture keeps them in memory.
+struct TiledTextureHeader
+{
+    char magic[4];          //"RTTX"
+    uint32_t version;
+    uint32_t format;        //TextureFormat
+    uint32_t levelCount;
+    int32_t width, height;
+    uint32_t pageSize;      //Page edge in texels
+    uint32_t texelBytes;
+    uint64_t dataOffset;    //Page aligned start of the texel data
+    uint64_t sourceSize;    //Size and modification time of the image it was converted from, to notice edits
+    int64_t sourceTime;
+};
+
+struct TiledTextureLevel
+{
+    int32_t width, height;
+    int32_t pagesX, pagesY;
+    uint64_t firstTexel;    //From the start of the texel data, always a whole number of pages
+};
+
+// Read-only handle of a tiled texture file, pages are read with pread so all render threads can share it
+class TiledTextureFile
+{
+public:
+    static constexpr uint32_t Version = 2;
+
+    ~TiledTextureFile();
+
+    // Null if path can't be opened, isn't a tiled texture of this version or has levels that don't fit in the file
+    static std::shared_ptr<TiledTextureFile> Open(const std::string& path);
+
+    // Writes a tiled texture, data holds every level's pages back to back
+    static bool Write(const std::string& path, const TiledTextureHeader& header, const std::vector<TiledTextureLevel>& levels, const uint8_t* data, size_t size);
+
+    bool ReadPage(uint64_t page, uint8_t* out) const;
+
+    // Size and modification time of a file as stored in the header, false if it can't be read
+    static bool SourceStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+    // False if source changed since this file was converted from it. A missing source can't be decoded instead,
+    // so the file is still considered current then.
+    bool MatchesSource(const std::string& source) const;
+
+    uint64_t Id() const { return mId; }
+    size_t PageBytes() const { return (size_t)mHeader.pageSize * mHeader.pageSize * mHeader.texelBytes; }
+    const TiledTextureHeader& Header() const { return mHeader; }
+    const std::vector<TiledTextureLevel>& Levels() const { return mLevels; }
+
+private:
+    TiledTextureFile() = default;
+
+    static bool validLayout(const TiledTextureHeader& header, const std::vector<TiledTextureLevel>& levels, uint64_t fileSize);
+
+    uint64_t mId = 0;
+    TiledTextureHeader mHeader;
+    std::vector<TiledTextureLevel> mLevels;
+#ifdef _WIN32
+    mutable std::mutex mFileMutex;
+    mutable std::ifstream mFile;
+#else
+    int mFile = -1;
+#endif
+};
+
+struct TileCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t bytesRead = 0;
+    uint64_t readErrors = 0;
+    size_t residentBytes = 0;
+    size_t capacityBytes = 0;
+
+    double HitRate() const { return hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0; }
+};
+
+// Fixed size cache of texture pages shared by all render threads. Pages are spread over shards by key,
+// each with its own lock and LRU list, so threads reading different pages rarely wait on each other.
+// A fetched page stays valid as long as the caller holds it, even if the cache drops it meanwhile.
+class TextureTileCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<uint8_t>> Page;
+
+    static TextureTileCache& Get();
+
+    // Page of file, read from disk on a miss
+    Page Fetch(const TiledTextureFile& file, uint64_t page);
+
+    void SetCapacity(size_t bytes);
+    TileCacheStats Stats() const;
+
+    // Zeroes the counters, e.g. at the start of a render
+    void ResetStats();
+
+private:
+    static constexpr int ShardCount = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<std::pair<uint64_t, Page>> lru; //Most recently used first
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Page>>::iterator> pages;
+        size_t bytes = 0;
+        uint64_t hits = 0, misses = 0, bytesRead = 0, readErrors = 0;
+    };
+
+    TextureTileCache() = default;
+
+    mutable Shard mShards[ShardCount];
+    std::atomic<size_t> mCapacity{ 256ull * 1024 * 1024 };
+
+    static void trim(Shard& shard, size_t capacity);
+};
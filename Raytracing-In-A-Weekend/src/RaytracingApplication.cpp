@@ -3,8 +3,9 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "Core/Mesh.h"
-#include "Core/Hittable.h"
-#include "AccelerationStructures/Bvh.h"
+#include "Core/MemoryTracker.h"
+#include "Core/Scenes.h"
+#include "Material/TextureCache.h"
 #include "Shader/Shader.h"
 #include "Shader/ComputeShader.h"
 
@@ -17,13 +18,21 @@ static int maxDepth = 50;
 static bool useMultithreading = true;
 static bool useGPUTracing = false;
 static bool useBuildUpRender = true;
+static char environmentMapPath[256] = "";
+static RadianceCacheSettings radianceCacheSettings;
+static PhotonMapSettings photonMapSettings;
+static TileSettings tileSettings;
+static TonemapSettings tonemapSettings;
+static NumaSettings numaSettings;
+static int textureBudgetMB = 0;
+static bool compactMeshes = false;
 
 // timing 
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f; // time of last frame
 
 RaytracingApplication::RaytracingApplication()
-	: running(false), imageTexture(0),
+	: running(false), renderControl(1), imageTexture(0), pixelBuffers{ 0, 0 }, pixelBufferIndex(0), uploadedImage(nullptr), uploadedWidth(0), uploadedHeight(0),
 	window(glfwCreateWindow(1600, 900, "Raytracing in a Weekend impl. by Yannik Hodel", NULL, NULL)), screenWidth(1600), screenHeight(900),
 	imageTextureData(std::make_shared<std::vector<GLubyte>>()), renderTimeString("Time to render: 0.0s")
 {
@@ -50,10 +59,12 @@ RaytracingApplication::RaytracingApplication()
 
 RaytracingApplication::~RaytracingApplication()
 {
-	if(raytracerPtr)
-		raytracerPtr->Cancel();
-	if(raytracerThread && raytracerThread->joinable())
-		raytracerThread->join();
+	{
+		const std::lock_guard<std::mutex> lock(raytracerMutex);
+		if (renderJob)
+			renderJob->Cancel();
+	}
+	renderControl.Wait();
 	raytracerPtr.release();
 
 	ImGui_ImplOpenGL3_Shutdown();
@@ -101,6 +112,7 @@ void RaytracingApplication::Run()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	displayShader.use();
 	displayShader.setInt("ImageTexture", 0);
+	glGenBuffers(2, pixelBuffers);
 
 	int sampleCounter = 0;
 	Scene gpuRaytracingScene;
@@ -108,21 +120,19 @@ void RaytracingApplication::Run()
 	{
 		glfwPollEvents();
 
-		if (raytracerThread && !running && raytracerThread->joinable())
-			raytracerThread->join();
-
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
 
 		ImGuiWindowFlags windowFlags = ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize;
 		ImGui::Begin("Render settings", NULL, windowFlags);
-		ImGui::SetWindowSize({ 400.0f, 215.0f });
+		ImGui::SetWindowSize({ 400.0f, 465.0f + (useMultithreading ? 100.0f : 0.0f) + (radianceCacheSettings.enabled ? 75.0f : 0.0f) + (photonMapSettings.enabled ? 50.0f : 0.0f) });
 		ImGui::SetWindowPos({ 0.0f, 0.0f });
 
 		if (ImGui::Checkbox("Use GPU Raytracer", &useGPUTracing) && useGPUTracing)
 		{
 			sampleCounter = 0;
+			uploadedImage = nullptr;
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, imageTexture);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -152,9 +162,37 @@ void RaytracingApplication::Run()
 		ImGui::InputInt("Image height", &imageHeightSetting);
 		ImGui::InputInt("Samples per pixel", &samplesPerPixel);
 		ImGui::InputInt("Max depth", &maxDepth);
+		ImGui::InputText("Environment map", environmentMapPath, sizeof(environmentMapPath));
 
 		ImGui::Checkbox("Use multithreading", &useMultithreading);
+		if (useMultithreading)
+		{
+			ImGui::InputInt("Threads (0 = auto)", &tileSettings.threadCount);
+			ImGui::InputInt("Tile size", &tileSettings.tileSize);
+			const char* tileOrders[] = { "Scanline", "Morton", "Hilbert", "Spiral" };
+			int tileOrder = (int)tileSettings.order;
+			if (ImGui::Combo("Tile order", &tileOrder, tileOrders, IM_ARRAYSIZE(tileOrders)))
+				tileSettings.order = (TileOrder)tileOrder;
+			ImGui::Checkbox("Pin threads to cores", &numaSettings.pinThreads);
+			ImGui::SameLine();
+			ImGui::Checkbox("Interleave scene memory", &numaSettings.interleaveSceneMemory);
+		}
 		ImGui::Checkbox("Use build up render", &useBuildUpRender);
+		ImGui::Checkbox("Use radiance cache", &radianceCacheSettings.enabled);
+		if (radianceCacheSettings.enabled)
+		{
+			ImGui::InputInt("Cache start bounce", &radianceCacheSettings.startBounce);
+			ImGui::InputFloat("Cache cell size", &radianceCacheSettings.cellSize);
+			ImGui::InputInt("Cache min samples", &radianceCacheSettings.minSamples);
+		}
+		ImGui::Checkbox("Use caustic photon map", &photonMapSettings.enabled);
+		if (photonMapSettings.enabled)
+		{
+			ImGui::InputInt("Photon count", &photonMapSettings.photonCount);
+			ImGui::InputFloat("Photon radius", &photonMapSettings.gatherRadius);
+		}
+		ImGui::InputInt("Texture budget MB (0 = none)", &textureBudgetMB);
+		ImGui::Checkbox("Compact mesh vertices", &compactMeshes);
 
 		if (ImGui::Button("Render"))
 		{
@@ -170,19 +208,67 @@ void RaytracingApplication::Run()
 		ImGui::SameLine();
 		if (ImGui::Button("Cancel"))
 		{
-			if (running && raytracerPtr)
-			{
-				raytracerPtr->Cancel();
-				running = false;
-			}
-			if (raytracerThread && raytracerThread->joinable())
-				raytracerThread->join();
+			//Only flags the job, the render control thread stops at the next check and clears running
+			const std::lock_guard<std::mutex> lock(raytracerMutex);
+			if (running && renderJob)
+				renderJob->Cancel();
 		}
 		ImGui::SameLine();
-		ImGui::Text(renderTimeString.c_str());
+		std::string timeText;
+		{
+			const std::lock_guard<std::mutex> lock(raytracerMutex);
+			timeText = renderTimeString;
+		}
+		ImGui::Text("%s", timeText.c_str());
+
+		//Applied to the finished image as well, the render keeps its linear samples
+		const char* tonemapOperators[] = { "Gamma", "Reinhard", "ACES" };
+		int tonemapOperator = (int)tonemapSettings.op;
+		if (ImGui::Combo("Tonemap", &tonemapOperator, tonemapOperators, IM_ARRAYSIZE(tonemapOperators)))
+			tonemapSettings.op = (TonemapOperator)tonemapOperator;
+		ImGui::InputFloat("Exposure", &tonemapSettings.exposure);
 		ImGui::EndDisabled();
+
+		std::vector<DirtyRect> dirtyRects;
+		std::shared_ptr<RenderJob> job;
+		{
+			const std::lock_guard<std::mutex> lock(raytracerMutex);
+			if (raytracerPtr && !useGPUTracing)
+			{
+				raytracerPtr->UpdateDisplay(tonemapSettings);
+				dirtyRects = raytracerPtr->DirtyRegions().Take();
+				job = renderJob;
+			}
+		}
+		if (job)
+		{
+			RenderProgress progress = job->Progress();
+			std::string overlay = std::to_string((int)(progress.Fraction() * 100.0f)) + "%";
+			if (progress.cancelled)
+				overlay += " cancelled";
+			else if (progress.etaSeconds > 0.0)
+				overlay += ", " + std::to_string((int)progress.etaSeconds) + "s left";
+			ImGui::ProgressBar(progress.Fraction(), ImVec2(-1.0f, 0.0f), overlay.c_str());
+			ImGui::Text("Pass %d/%d, %.2f Mrays/s", progress.passesDone, progress.totalPasses, progress.RaysPerSecond() * 1e-6);
+		}
+		TextureCacheStats textureStats = TextureCache::Get().Stats();
+		ImGui::Text("Textures: %d, %.1f MB, %d hits, %d misses", (int)textureStats.entries, textureStats.residentBytes / (1024.0 * 1024.0), (int)textureStats.hits, (int)textureStats.misses);
+		TileCacheStats tileStats = TextureTileCache::Get().Stats();
+		if (tileStats.hits + tileStats.misses > 0)
+			ImGui::Text("Streamed pages: %.1f%% hits, %.1f MB read", tileStats.HitRate() * 100.0, tileStats.bytesRead / (1024.0 * 1024.0));
+		if (ImGui::CollapsingHeader("Memory"))
+		{
+			for (int category = 0; category < (int)MemoryCategory::Count; category++)
+			{
+				MemoryUsage usage = MemoryTracker::Get().Usage((MemoryCategory)category);
+				ImGui::Text("%s: %.1f MB, peak %.1f MB", MemoryTracker::Name((MemoryCategory)category), usage.currentBytes / (1024.0 * 1024.0), usage.peakBytes / (1024.0 * 1024.0));
+			}
+			MemoryUsage total = MemoryTracker::Get().Total();
+			ImGui::Text("total: %.1f MB, peak %.1f MB", total.currentBytes / (1024.0 * 1024.0), total.peakBytes / (1024.0 * 1024.0));
+		}
 		ImGui::End();
 
+
 		displayShader.use();
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -191,7 +277,7 @@ void RaytracingApplication::Run()
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 		glBindTexture(GL_TEXTURE_2D, imageTexture);
 		if(!useGPUTracing)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageTextureData->data());
+			uploadImage(dirtyRects);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, imageTexture);
 
@@ -204,6 +290,7 @@ void RaytracingApplication::Run()
 
 			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
+			const std::lock_guard<std::mutex> lock(raytracerMutex);
 			renderTimeString = std::string("Frametime: " + std::to_string(glfwGetTime() - startTime) + "s");
 		}
 
@@ -221,6 +308,57 @@ void RaytracingApplication::Run()
 	}
 }
 
+void RaytracingApplication::uploadImage(const std::vector<DirtyRect>& dirtyRects)
+{
+	//A new render or size needs the whole texture, otherwise only the regions the raytracer rewrote
+	if (uploadedImage != imageTextureData->data() || uploadedWidth != imageWidth || uploadedHeight != imageHeight)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageTextureData->data());
+		uploadedImage = imageTextureData->data();
+		uploadedWidth = imageWidth;
+		uploadedHeight = imageHeight;
+		return;
+	}
+	if (dirtyRects.empty())
+		return;
+
+	size_t uploadSize = 0;
+	for (const DirtyRect& rect : dirtyRects)
+		uploadSize += (size_t)(rect.x1 - rect.x0) * (rect.y1 - rect.y0) * 4;
+
+	//Orphaning the buffer lets the driver hand out fresh memory while the last upload from it may still be in flight
+	pixelBufferIndex = 1 - pixelBufferIndex;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[pixelBufferIndex]);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, uploadSize, NULL, GL_STREAM_DRAW);
+	GLubyte* mapped = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		uploadedImage = nullptr;
+		return;
+	}
+
+	size_t offset = 0;
+	for (const DirtyRect& rect : dirtyRects)
+	{
+		size_t rowSize = (size_t)(rect.x1 - rect.x0) * 4;
+		for (int y = rect.y0; y < rect.y1; y++)
+		{
+			memcpy(mapped + offset, imageTextureData->data() + ((size_t)y * imageWidth + rect.x0) * 4, rowSize);
+			offset += rowSize;
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	offset = 0;
+	for (const DirtyRect& rect : dirtyRects)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)offset);
+		offset += (size_t)(rect.x1 - rect.x0) * (rect.y1 - rect.y0) * 4;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
 void RaytracingApplication::framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
@@ -245,32 +383,62 @@ void RaytracingApplication::runRaytracer()
 {
 	imageTextureData = std::make_shared<std::vector<GLubyte>>();
 	imageTextureData->resize(imageWidth * imageHeight * 4);
-	raytracerThread = std::make_unique<std::thread>([this]
+	int threadCount = TileScheduler::ResolveThreadCount(tileSettings.threadCount);
+	if (useMultithreading && (!renderPool || renderPool->ThreadCount() != threadCount || renderPool->Pinned() != numaSettings.pinThreads))
+		renderPool = std::make_shared<ThreadPool>(threadCount, numaSettings.pinThreads);
+	TextureCache::Get().SetBudget((size_t)std::max(textureBudgetMB, 0) * 1024 * 1024);
+	TextureTileCache::Get().ResetStats();
+	Mesh::SetVertexFormat(compactMeshes ? MeshVertexFormat::Compact : MeshVertexFormat::Full);
+
+	//The job exists from the moment Render is pressed, so Cancel also reaches a render whose scene is still loading
+	std::shared_ptr<RenderJob> job = std::make_shared<RenderJob>();
+	job->SetCompletionCallback([this](const RenderProgress& progress)
+		{
+			{
+				const std::lock_guard<std::mutex> lock(raytracerMutex);
+				renderTimeString = std::string("Time to render: " + std::to_string(progress.elapsedSeconds) + "s" + (progress.cancelled ? " (cancelled)" : ""));
+			}
+			std::cerr << "Render " << (progress.cancelled ? "cancelled" : "finished") << " after " << progress.elapsedSeconds << "s, " << progress.raysTraced << " rays." << std::endl;
+		});
+	{
+		const std::lock_guard<std::mutex> lock(raytracerMutex);
+		renderJob = job;
+	}
+
+	renderControl.Submit([this, job]
 		{
 			//Image
 			const float aspectRatio = imageWidth / imageHeight;
 
+			//Scene data is read by every node's workers, so spread it instead of piling it onto this thread's node
+			ScopedMemoryInterleave interleave(useMultithreading && numaSettings.interleaveSceneMemory);
+
 			//World
 			Scene renderScene = setupWorld();
-			
-
-			float startTime = glfwGetTime();
+			if (job->Cancelled())
+			{
+				job->Finish();
+				running = false;
+				return;
+			}
 
 			//Render
+			std::unique_ptr<Raytracer> raytracer;
 			if (useMultithreading)
 			{
-				raytracerPtr = std::make_unique<RaytracerMT>(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, useBuildUpRender);
+				raytracer = std::make_unique<RaytracerMT>(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, useBuildUpRender, radianceCacheSettings, photonMapSettings, tileSettings, renderPool);
 			}
 			else
 			{
-				raytracerPtr = std::make_unique<RaytracerNormal>(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, useBuildUpRender);
+				raytracer = std::make_unique<RaytracerNormal>(imageTextureData, renderScene, imageHeight, imageWidth, samplesPerPixel, maxDepth, useBuildUpRender, radianceCacheSettings, photonMapSettings);
+			}
+			raytracer->SetJob(job);
+			{
+				const std::lock_guard<std::mutex> lock(raytracerMutex);
+				raytracerPtr = std::move(raytracer);
 			}
 
 			raytracerPtr->Run();
-
-			float endTime = glfwGetTime();
-
-			renderTimeString = std::string("Time to render: " + std::to_string(endTime - startTime) + "s");
 			running = false;
 		});
 }
@@ -293,57 +461,9 @@ Scene RaytracingApplication::setupWorld()
 	}
 	else
 	{
-		HittableList world = cornellBox();// = randomScene();
-		glm::vec3 background = glm::vec3(0.0f, 0.0f, 0.0f);
-
-		glm::mat4 vaseModelMatrix(1.0f);
-		vaseModelMatrix = glm::translate(vaseModelMatrix, { 277.5f, 100.00f, 277.5f });
-		vaseModelMatrix = glm::scale(vaseModelMatrix, { 2000.0f, 2000.0f, 2000.0f });
-		/* For Make-shift cornell box
-		vaseModelMatrix = glm::translate(vaseModelMatrix, { 0.0f, 0.02f, 0.0f });
-		vaseModelMatrix = glm::scale(vaseModelMatrix, {0.5f, 0.5f, 0.5f});
-		*/
-		world.add(std::make_shared<Mesh>(vaseModelMatrix, "assets/models/brass_vase/brass_vase_04_4k.gltf"));
-
-		/*
-		auto white = std::make_shared<Lambertian>(glm::vec3(0.73f, 0.73f, 0.73f));
-
-		glm::mat4 box1Model(1.0f);
-		box1Model = glm::translate(box1Model, glm::vec3(265.0f, 0.0f, 295.0f));
-		box1Model = glm::rotate(box1Model, glm::radians(15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		world.add(std::make_shared<Box>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(165.0f, 330.0f, 165.0f), white, box1Model));
-
-		glm::mat4 box2Model(1.0f);
-		box2Model = glm::translate(box2Model, glm::vec3(130.0f, 0.0f, 65.0f));
-		box2Model = glm::rotate(box2Model, glm::radians(-18.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		world.add(std::make_shared<Box>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(165.0f, 165.0f, 165.0f), white, box2Model));
-		*/
-
-		/* Make-shift cornell box
-		auto greenMat = std::make_shared<Lambertian>(glm::vec3(0.0f, 1.0f, 0.0f));
-		auto redMat = std::make_shared<Lambertian>(glm::vec3(1.0f, 0.0f, 0.0f));
-		auto blueMat = std::make_shared<Lambertian>(glm::vec3(0.0f, 0.0f, 1.0f));
-		auto groundMaterial = std::make_shared<Lambertian>(glm::vec3(0.5f, 0.5f, 0.5f));
-		auto lightMat = std::make_shared<DiffuseLight>(glm::vec3(1.0f, 1.0f, 1.0f));
-		world.add(std::make_shared<Sphere>(glm::vec3(1.1f, 0.0f, 0.0f), 1.0f, greenMat));
-		world.add(std::make_shared<Sphere>(glm::vec3(-1.1f, 0.0f, 0.0f), 1.0f, redMat));
-		world.add(std::make_shared<Sphere>(glm::vec3(0.0f, 0.0f, 1.1f), 1.0f, blueMat));
-		world.add(std::make_shared<Sphere>(glm::vec3(0.0f, 1.3f, 0.0f), 1.1f, lightMat));
-		world.add(std::make_shared<Sphere>(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMaterial));
-		*/
-
-		//Camera
-		const float aspectRatio = imageWidth / imageHeight;
-		glm::vec3 lookfrom = { 278.0f, 278.0f, -800.0f };
-		//glm::vec3 lookfrom = { 0.0f, 0.1f, -0.5f };
-		//glm::vec3 lookat = { 0.0f, 0.1f, 0.0f };
-		glm::vec3 lookat = { 278.0f, 278.0f, 0.0f };
-		glm::vec3 vup = { 0.0f, 1.0f, 0.0f };
-		float distToFocus = 10.0f;
-		float aperture = 0.0f;
-		Camera cam(lookfrom, lookat, vup, 40.0f, aspectRatio, aperture, distToFocus);
-
-		return { world, cam, background };
+		Scene scene;
+		buildScene("cornell-vase", (float)imageWidth / imageHeight, environmentMapPath, scene);
+		return scene;
 	}
 }
 
@@ -355,124 +475,3 @@ int main()
 	RaytracingApplication app;
 	app.Run();
 }
-
-HittableList randomScene() {
-	HittableList world;
-
-	auto groundMaterial = std::make_shared<Lambertian>(glm::vec3(0.5f, 0.5f, 0.5f));
-	world.add(std::make_shared<Sphere>(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMaterial));
-
-	for (int a = -11; a < 11; a++) {
-		for (int b = -11; b < 11; b++) {
-			auto chooseMat = randomFloat();
-			glm::vec3 center(a + 0.9f * randomFloat(), 0.2f, b + 0.9f * randomFloat());
-
-			if ((center - glm::vec3(4.0f, 0.2f, 0.0f)).length() > 0.9f) {
-				std::shared_ptr<Material> sphereMaterial;
-
-				if (chooseMat < 0.8f) {
-					// diffuse
-					auto albedo = randomVec() * randomVec();
-					sphereMaterial = std::make_shared<Lambertian>(albedo);
-					world.add(std::make_shared<Sphere>(center, 0.2f, sphereMaterial));
-				}
-				else if (chooseMat < 0.95f) {
-					// metal
-					auto albedo = randomVec(0.5f, 1.0f);
-					auto fuzz = randomFloat(0.0f, 0.5f);
-					sphereMaterial = std::make_shared<Metal>(albedo, fuzz);
-					world.add(std::make_shared<Sphere>(center, 0.2f, sphereMaterial));
-				}
-				else {
-					// glass
-					sphereMaterial = std::make_shared<Dielectric>(1.5f);
-					world.add(std::make_shared<Sphere>(center, 0.2f, sphereMaterial));
-				}
-			}
-		}
-	}
-
-	auto material1 = std::make_shared<Dielectric>(1.5f);
-	world.add(make_shared<Sphere>(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, material1));
-
-	auto material2 = std::make_shared<Lambertian>(glm::vec3(0.4f, 0.2f, 0.1f));
-	world.add(std::make_shared<Sphere>(glm::vec3(-4.0f, 1.0f, 0.0f), 1.0f, material2));
-
-	auto material3 = std::make_shared<Metal>(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f);
-	world.add(std::make_shared<Sphere>(glm::vec3(4.0f, 1.0f, 0.0f), 1.0f, material3));
-
-	return world;
-}
-
-HittableList cornellBox()
-{
-	HittableList objects;
-
-	auto red = std::make_shared<Lambertian>(glm::vec3(0.65f, 0.05f, 0.05f));
-	auto white = std::make_shared<Lambertian>(glm::vec3(0.73f, 0.73f, 0.73f));
-	auto green = std::make_shared<Lambertian>(glm::vec3(0.12f, 0.45f, 0.15f));
-	auto light = std::make_shared<DiffuseLight>(glm::vec3(15.0f, 15.0f, 15.0f));
-
-	Vertex vert0;
-	Vertex vert1;
-	Vertex vert2;
-	vert0.normal = { 0.0f, 0.0f, 0.0f };
-	vert1.normal = { 0.0f, 0.0f, 0.0f };
-	vert2.normal = { 0.0f, 0.0f, 0.0f };
-
-	vert0.position = glm::vec3(555.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 555.0f, 0.0f);
-	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), green, ""));
-	vert0.position = glm::vec3(555.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	vert2.position = glm::vec3(555.0f, 0.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), green, "")); //Left
-
-	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(0.0f, 555.0f, 0.0f);
-	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), red, ""));
-	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(0.0f, 555.0f, 555.0f);
-	vert2.position = glm::vec3(0.0f, 0.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), red, "")); //Right
-
-	vert0.position = glm::vec3(213.0f, 554.0f, 227.0f);
-	vert1.position = glm::vec3(343.0f, 554.0f, 227.0f);
-	vert2.position = glm::vec3(343.0f, 554.0f, 332.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), light, ""));
-	vert0.position = glm::vec3(213.0f, 554.0f, 227.0f);
-	vert1.position = glm::vec3(343.0f, 554.0f, 332.0f);
-	vert2.position = glm::vec3(213.0f, 554.0f, 332.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), light, "")); //Light
-
-	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 0.0f, 0.0f);
-	vert2.position = glm::vec3(555.0f, 0.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, ""));
-	vert0.position = glm::vec3(0.0f, 0.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 0.0f, 555.0f);
-	vert2.position = glm::vec3(0.0f, 0.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "")); //Floor
-
-	vert0.position = glm::vec3(0.0f, 555.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 555.0f, 0.0f);
-	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, ""));
-	vert0.position = glm::vec3(0.0f, 555.0f, 0.0f);
-	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "")); //Top
-
-	vert0.position = glm::vec3(0.0f, 0.0f, 555.0f);
-	vert1.position = glm::vec3(555.0f, 0.0f, 555.0f);
-	vert2.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "back"));
-	vert0.position = glm::vec3(0.0f, 0.0f, 555.0f);
-	vert1.position = glm::vec3(555.0f, 555.0f, 555.0f);
-	vert2.position = glm::vec3(0.0f, 555.0f, 555.0f);
-	objects.add(make_shared<Triangle>(vert0, vert1, vert2, glm::mat4(1.0f), white, "back")); //Back
-
-	return objects;
-}
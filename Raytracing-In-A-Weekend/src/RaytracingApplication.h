@@ -1,6 +1,8 @@
 #pragma once
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <vector>
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -23,19 +25,24 @@ public:
 
 private:
     GLFWwindow* window;
-    bool running;
-    std::unique_ptr<std::thread> raytracerThread;
+    std::atomic_bool running; //Written by the render control thread when a render ends
+    ThreadPool renderControl; //Single thread driving the current render so the UI stays responsive
+    std::shared_ptr<ThreadPool> renderPool; //Workers shared by every multithreaded render
     std::unique_ptr<Raytracer> raytracerPtr;
+    std::shared_ptr<RenderJob> renderJob; //Job of the current render, created before its scene loads so Cancel always has something to flag
+    std::mutex raytracerMutex; //Guards replacing raytracerPtr, renderJob and renderTimeString while the UI reads them
     uint32_t imageTexture;
+    uint32_t pixelBuffers[2]; //Alternating upload buffers so filling one never waits on the copy out of the other
+    int pixelBufferIndex;
+    const GLubyte* uploadedImage; //Display buffer the texture currently holds, null forces a full upload
+    int uploadedWidth, uploadedHeight;
     int32_t screenWidth, screenHeight;
     std::shared_ptr<std::vector<GLubyte>> imageTextureData;
-    std::string renderTimeString;
+    std::string renderTimeString; //Set by the completion callback on the render control thread
 
     static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
     static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
     Scene setupWorld();
+    void uploadImage(const std::vector<DirtyRect>& dirtyRects);
 };
-
-HittableList randomScene();
-HittableList cornellBox();
\ No newline at end of file
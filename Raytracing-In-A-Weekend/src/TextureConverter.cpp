@@ -0,0 +1,66 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Material/Texture.h"
+
+// Converts images into the tiled, mip mapped texture format that is streamed through the TextureTileCache.
+// The output goes next to the source where the texture cache looks for it, e.g. wood.jpg -> wood.jpg.color.rtx.
+
+static void printUsage()
+{
+	std::cerr << "Usage: Raytracing-In-A-Weekend-texconv [--usage color|linear|roughness] IMAGE...\n"
+		<< "  --usage NAME   How the following images are used by materials (color)\n"
+		<< "                 color: albedo and emission, linear: normal maps, roughness: roughness maps" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	TextureUsage usage = TextureUsage::Color;
+	int converted = 0, failed = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			printUsage();
+			return 0;
+		}
+		if (arg == "--usage")
+		{
+			std::string value = i + 1 < argc ? argv[++i] : "";
+			if (value == "color")
+				usage = TextureUsage::Color;
+			else if (value == "linear")
+				usage = TextureUsage::Linear;
+			else if (value == "roughness")
+				usage = TextureUsage::Roughness;
+			else
+			{
+				std::cerr << "Unknown usage " << value << std::endl;
+				printUsage();
+				return 2;
+			}
+			continue;
+		}
+
+		Texture texture(arg.c_str(), usage);
+		std::string output = Texture::TiledPath(arg, usage);
+		if (!texture.Valid() || texture.Streamed() || !texture.WriteTiled(output, arg))
+		{
+			std::cerr << "Could not convert " << arg << std::endl;
+			failed++;
+			continue;
+		}
+		std::cout << arg << " -> " << output << " (" << texture.Width() << "x" << texture.Height() << ", " << texture.LevelCount() << " levels, "
+			<< texture.Bytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+		converted++;
+	}
+
+	if (converted + failed == 0)
+	{
+		printUsage();
+		return 2;
+	}
+	return failed > 0 ? 1 : 0;
+}